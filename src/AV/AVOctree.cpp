@@ -0,0 +1,258 @@
+#include "AVOctree.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+AVOctree::AVOctree(const std::vector<Eigen::Vector4f> &points)
+{
+	using Eigen::Vector3f;
+	for (const Eigen::Vector4f &point : points) {
+		if (point[3] > 0.0f) {
+			_points.push_back(point);
+		}
+	}
+	if (_points.empty()) {
+		return;
+	}
+	Vector3f lo = _points[0].head<3>(), hi = lo;
+	for (const Eigen::Vector4f &point : _points) {
+		lo = lo.cwiseMin(point.head<3>());
+		hi = hi.cwiseMax(point.head<3>());
+	}
+	Node root;
+	root.begin = 0;
+	root.end = _points.size();
+	root.child = root.childCount = 0;
+	summarize(root);
+	_nodes.push_back(root);
+	divide(0, (lo + hi) * 0.5f, (hi - lo).maxCoeff() * 0.5f);
+}
+
+void AVOctree::summarize(AVOctree::Node &node) const
+{
+	Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+	node.weight = 0.0;
+	for (int i = node.begin; i < node.end; ++i) {
+		const double w = _points[i][3];
+		sum += _points[i].head<3>().cast<double>() * w;
+		node.weight += w;
+	}
+	node.centroid = sum / node.weight;
+	double variance = 0.0, radiusSq = 0.0;
+	for (int i = node.begin; i < node.end; ++i) {
+		const double rSq = (_points[i].head<3>().cast<double>()
+				    - node.centroid)
+					   .squaredNorm();
+		variance += _points[i][3] * rSq;
+		radiusSq = std::max(radiusSq, rSq);
+	}
+	node.variance = variance / node.weight;
+	node.radius = std::sqrt(radiusSq);
+}
+
+void AVOctree::divide(int node, const Eigen::Vector3f &center, float half)
+{
+	const int begin = _nodes[node].begin, end = _nodes[node].end;
+	// coinciding points would be divided forever
+	if (end - begin <= leafSize || half < 1e-3f) {
+		return;
+	}
+	// octant 4*(x>=cx)+2*(y>=cy)+(z>=cz) covers [bounds[o],bounds[o+1])
+	std::array<int, 9> bounds;
+	auto split = [this, &center](int from, int to, int axis) {
+		auto first = _points.begin();
+		auto below = [&center, axis](const Eigen::Vector4f &p) {
+			return p[axis] < center[axis];
+		};
+		return int(std::partition(first + from, first + to, below)
+			   - first);
+	};
+	bounds[0] = begin;
+	bounds[8] = end;
+	bounds[4] = split(begin, end, 0);
+	bounds[2] = split(begin, bounds[4], 1);
+	bounds[6] = split(bounds[4], end, 1);
+	for (int o = 0; o < 8; o += 2) {
+		bounds[o + 1] = split(bounds[o], bounds[o + 2], 2);
+	}
+
+	const int first = _nodes.size();
+	for (int o = 0; o < 8; ++o) {
+		if (bounds[o] == bounds[o + 1]) {
+			continue;
+		}
+		Node child;
+		child.begin = bounds[o];
+		child.end = bounds[o + 1];
+		child.child = child.childCount = 0;
+		summarize(child);
+		_nodes.push_back(child);
+	}
+	_nodes[node].child = first;
+	_nodes[node].childCount = _nodes.size() - first;
+
+	const float quarter = half * 0.5f;
+	int child = first;
+	for (int o = 0; o < 8; ++o) {
+		if (bounds[o] == bounds[o + 1]) {
+			continue;
+		}
+		const Eigen::Vector3f shift(o & 4 ? quarter : -quarter,
+					    o & 2 ? quarter : -quarter,
+					    o & 1 ? quarter : -quarter);
+		divide(child++, center + shift, quarter);
+	}
+}
+
+namespace
+{
+// largest absolute eigenvalue of the Hessian of e(|x|), e(r)=1/(1+r^6):
+// the eigenvalues are e''(r) and e'(r)/r
+double hessianNorm(double r)
+{
+	const double r4 = r * r * r * r, s = r4 * r * r, den = 1.0 + s;
+	return std::max(r4 * std::abs(42.0 * s - 30.0) / (den * den * den),
+			6.0 * r4 / (den * den));
+}
+
+// upper bound of hessianNorm(r) for r in [r0,r1]
+double hessianNormBound(double r0, double r1)
+{
+	// maxima over the bins [k*binWidth,(k+1)*binWidth) of [0,rMax) from
+	// samples spaced by binWidth/256 and |hessianNorm'|<31, hessianNorm
+	// decreases beyond rMax
+	static constexpr double binWidth = 0.05, rMax = 5.0;
+	static constexpr int bins = rMax / binWidth, samples = 256;
+	static const std::vector<double> table = [] {
+		std::vector<double> table(bins);
+		const double margin = 31.0 * binWidth / samples * 0.5;
+		for (int k = 0; k < bins; ++k) {
+			double max = 0.0;
+			for (int i = 0; i <= samples; ++i) {
+				const double r = (k + double(i) / samples)
+						 * binWidth;
+				max = std::max(max, hessianNorm(r));
+			}
+			table[k] = max + margin;
+		}
+		return table;
+	}();
+	if (r0 >= rMax) {
+		return hessianNorm(r0);
+	}
+	const int last = std::min(bins - 1, int(r1 / binWidth));
+	double max = r1 >= rMax ? hessianNorm(rMax) : 0.0;
+	for (int k = int(r0 / binWidth); k <= last; ++k) {
+		max = std::max(max, table[k]);
+	}
+	return max;
+}
+} // namespace
+
+template <typename Bound, typename Value>
+BoundedValue AVOctree::pairMean(const AVOctree &other, double tolerance,
+				Bound &&bound, Value &&value) const
+{
+	if (empty() || other.empty()) {
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		return {nan, nan};
+	}
+	// sums of w1*w2*value and of w1*w2*bound over the accepted pairs
+	double sum = 0.0, error = 0.0;
+	std::vector<std::pair<int, int>> stack{{0, 0}};
+	while (!stack.empty()) {
+		const Node &a = _nodes[stack.back().first];
+		const Node &b = other._nodes[stack.back().second];
+		const int ia = stack.back().first, ib = stack.back().second;
+		stack.pop_back();
+		const double w = a.weight * b.weight;
+		const BoundedValue estimate = bound(a, b);
+		if (estimate.bound <= tolerance) {
+			sum += w * estimate.value;
+			error += w * estimate.bound;
+			continue;
+		}
+		// refine the larger node, pairs of leaves are summed exactly
+		if (a.childCount > 0
+		    && (b.childCount == 0 || a.radius >= b.radius)) {
+			for (int c = a.child; c < a.child + a.childCount; ++c) {
+				stack.emplace_back(c, ib);
+			}
+		} else if (b.childCount > 0) {
+			for (int c = b.child; c < b.child + b.childCount; ++c) {
+				stack.emplace_back(ia, c);
+			}
+		} else {
+			for (int i = a.begin; i < a.end; ++i) {
+				const Eigen::Vector4d p =
+					_points[i].cast<double>();
+				for (int j = b.begin; j < b.end; ++j) {
+					const Eigen::Vector4d q =
+						other._points[j].cast<double>();
+					const double rSq =
+						(p - q).head<3>().squaredNorm();
+					sum += p[3] * q[3] * value(rSq);
+				}
+			}
+		}
+	}
+	const double total = _nodes[0].weight * other._nodes[0].weight;
+	return {sum / total, error / total};
+}
+
+BoundedValue AVOctree::meanDistance(const AVOctree &other,
+				    double tolerance) const
+{
+	// For the points p=ca+ea, q=cb+eb of the nodes a and b and d=|ca-cb|:
+	// d<=mean|p-q| (Jensen), |p-q|<=d+|ea|+|eb| and, as |c+e| is at most
+	// |c|+u.e+|e|^2/(2|c|) and the mean of ea-eb is zero,
+	// mean|p-q|<=d+(variance_a+variance_b)/(2d).
+	auto bound = [](const Node &a, const Node &b) {
+		const double d = (a.centroid - b.centroid).norm();
+		double width = a.radius + b.radius;
+		if (d > 0.0) {
+			width = std::min(width,
+					 (a.variance + b.variance) / (2.0 * d));
+		}
+		return BoundedValue{d + 0.5 * width, 0.5 * width};
+	};
+	auto value = [](double rSq) { return std::sqrt(rSq); };
+	return pairMean(other, tolerance, bound, value);
+}
+
+BoundedValue AVOctree::meanEfficiency(const AVOctree &other, double R0,
+				      double tolerance) const
+{
+	const double invR0Sq = 1.0 / (R0 * R0);
+	auto value = [invR0Sq](double rSq) {
+		const double s = rSq * invR0Sq;
+		return 1.0 / (1.0 + s * s * s);
+	};
+	// With the points within spread=radius_a+radius_b of d=|ca-cb|, the
+	// mean over the pair of nodes is E(d) within
+	// M/2*(variance_a+variance_b), M the largest eigenvalue of the Hessian
+	// of E(|x|) over [d-spread,d+spread] (second order Taylor expansion at
+	// the centroids, the first order term averages out). Close or large
+	// nodes use the range of E over the range of the distances instead.
+	const double invR0 = 1.0 / R0;
+	auto bound = [&value, invR0, invR0Sq](const Node &a, const Node &b) {
+		const double d = (a.centroid - b.centroid).norm();
+		const double spread = a.radius + b.radius;
+		const double rMin = std::max(0.0, d - spread);
+		const double rMax = d + spread;
+		const double eMin = value(rMax * rMax);
+		const double eMax = value(rMin * rMin);
+		const BoundedValue range{0.5 * (eMax + eMin),
+					 0.5 * (eMax - eMin)};
+		const double hessian =
+			hessianNormBound(rMin * invR0, rMax * invR0) * invR0Sq;
+		const BoundedValue expansion{
+			value(d * d),
+			0.5 * hessian * (a.variance + b.variance)};
+		return expansion.bound < range.bound ? expansion : range;
+	};
+	return pairMean(other, tolerance, bound, value);
+}
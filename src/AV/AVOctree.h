@@ -0,0 +1,62 @@
+#ifndef AVOCTREE_H
+#define AVOCTREE_H
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+// Estimate with a guaranteed bound of its error, |exact-value|<=bound
+struct BoundedValue {
+	double value;
+	double bound;
+};
+
+// Compressed AV: octree over the points, every node holds the total weight
+// of its points, their weighted centroid, the weighted mean squared
+// distance from the centroid (variance) and the largest one (radius).
+// The weighted means over all pairs of points of two AVs are evaluated on
+// pairs of nodes. Each pair of nodes gives an estimate with an error bound
+// from the node statistics, pairs with a bound above the tolerance are
+// refined down to the single points. So the bound of the result never
+// exceeds the tolerance, and the cost depends on the tolerance and on the
+// distance between the AVs rather than on the number of points.
+class AVOctree
+{
+public:
+	AVOctree() = default;
+	explicit AVOctree(const std::vector<Eigen::Vector4f> &points);
+
+	bool empty() const
+	{
+		return _nodes.empty();
+	}
+	// weighted mean of the distance over all pairs of points
+	BoundedValue meanDistance(const AVOctree &other,
+				  double tolerance) const;
+	// weighted mean of the FRET efficiency 1/(1+(r/R0)^6)
+	BoundedValue meanEfficiency(const AVOctree &other, double R0,
+				    double tolerance) const;
+
+	// nodes with at most this many points are not divided further
+	static constexpr int leafSize = 16;
+
+private:
+	struct Node {
+		Eigen::Vector3d centroid;
+		double weight, variance, radius;
+		// points [begin,end), children [child,child+childCount)
+		int begin, end, child, childCount;
+	};
+	void summarize(Node &node) const;
+	void divide(int node, const Eigen::Vector3f &center, float half);
+	template <typename Bound, typename Value>
+	BoundedValue pairMean(const AVOctree &other, double tolerance,
+			      Bound &&bound, Value &&value) const;
+
+	// points with nonzero weight, ordered so that every node covers a
+	// contiguous range
+	std::vector<Eigen::Vector4f> _points;
+	std::vector<Node> _nodes;
+};
+
+#endif // AVOCTREE_H
@@ -0,0 +1,444 @@
+#include "AVPoints.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <immintrin.h>
+
+namespace
+{
+// Points of the inner loop are processed in blocks, which stay in L1 cache
+// (4 arrays * 1024 floats = 16 KB) while all outer points are visited. The
+// per block sums are accumulated in float and added up in double.
+constexpr size_t blockSize = 1024;
+// coordinate of the padding points, far enough to contribute nothing, but
+// small enough for the squared distances to stay finite
+constexpr float farAway = 1e15f;
+
+struct View {
+	const float *x, *y, *z, *w;
+	size_t size; // number of points, padded for the inner loop
+};
+
+inline float horizontalSum(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+inline float horizontalMin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+inline __m128 distanceSqSse(const View &b, size_t j, __m128 xi, __m128 yi,
+			    __m128 zi)
+{
+	const __m128 dx = _mm_sub_ps(_mm_loadu_ps(b.x + j), xi);
+	const __m128 dy = _mm_sub_ps(_mm_loadu_ps(b.y + j), yi);
+	const __m128 dz = _mm_sub_ps(_mm_loadu_ps(b.z + j), zi);
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+			  _mm_mul_ps(dz, dz));
+}
+
+double efficiencySumSse(const View &a, const View &b, float invR0Sq)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(invR0Sq);
+	double sum = 0.0;
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m128 xi = _mm_set1_ps(a.x[i]);
+			const __m128 yi = _mm_set1_ps(a.y[i]);
+			const __m128 zi = _mm_set1_ps(a.z[i]);
+			__m128 acc = _mm_setzero_ps();
+			for (size_t j = j0; j < j1; j += 4) {
+				const __m128 s = _mm_mul_ps(
+					distanceSqSse(b, j, xi, yi, zi), scale);
+				const __m128 s6 =
+					_mm_mul_ps(_mm_mul_ps(s, s), s);
+				acc = _mm_add_ps(
+					acc, _mm_div_ps(_mm_loadu_ps(b.w + j),
+							_mm_add_ps(one, s6)));
+			}
+			sum += double(a.w[i]) * horizontalSum(acc);
+		}
+	}
+	return sum;
+}
+
+double distanceSumSse(const View &a, const View &b)
+{
+	double sum = 0.0;
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m128 xi = _mm_set1_ps(a.x[i]);
+			const __m128 yi = _mm_set1_ps(a.y[i]);
+			const __m128 zi = _mm_set1_ps(a.z[i]);
+			__m128 acc = _mm_setzero_ps();
+			for (size_t j = j0; j < j1; j += 4) {
+				const __m128 r = _mm_sqrt_ps(
+					distanceSqSse(b, j, xi, yi, zi));
+				acc = _mm_add_ps(
+					acc,
+					_mm_mul_ps(r, _mm_loadu_ps(b.w + j)));
+			}
+			sum += double(a.w[i]) * horizontalSum(acc);
+		}
+	}
+	return sum;
+}
+
+float minDistanceSqSse(const View &a, const View &b)
+{
+	__m128 acc = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m128 xi = _mm_set1_ps(a.x[i]);
+			const __m128 yi = _mm_set1_ps(a.y[i]);
+			const __m128 zi = _mm_set1_ps(a.z[i]);
+			for (size_t j = j0; j < j1; j += 4) {
+				acc = _mm_min_ps(
+					acc, distanceSqSse(b, j, xi, yi, zi));
+			}
+		}
+	}
+	return horizontalMin(acc);
+}
+
+// Sums over all pairs of w1*w2*r (sums[0]) and of w1*w2*E(r) for count
+// Forster radii (sums[1+k] for invR0Sq[k]), r is computed once per pair
+constexpr int maxFused = 7;
+
+void fusedSumsSse(const View &a, const View &b, const float *invR0Sq,
+		  int count, double *sums)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 scale[maxFused];
+	for (int k = 0; k < count; ++k) {
+		scale[k] = _mm_set1_ps(invR0Sq[k]);
+	}
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m128 xi = _mm_set1_ps(a.x[i]);
+			const __m128 yi = _mm_set1_ps(a.y[i]);
+			const __m128 zi = _mm_set1_ps(a.z[i]);
+			__m128 acc[1 + maxFused];
+			for (int k = 0; k <= count; ++k) {
+				acc[k] = _mm_setzero_ps();
+			}
+			for (size_t j = j0; j < j1; j += 4) {
+				const __m128 rSq =
+					distanceSqSse(b, j, xi, yi, zi);
+				const __m128 w = _mm_loadu_ps(b.w + j);
+				const __m128 r = _mm_sqrt_ps(rSq);
+				acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(r, w));
+				for (int k = 0; k < count; ++k) {
+					const __m128 s =
+						_mm_mul_ps(rSq, scale[k]);
+					const __m128 s6 = _mm_mul_ps(
+						_mm_mul_ps(s, s), s);
+					const __m128 e = _mm_div_ps(
+						w, _mm_add_ps(one, s6));
+					acc[k + 1] = _mm_add_ps(acc[k + 1], e);
+				}
+			}
+			for (int k = 0; k <= count; ++k) {
+				sums[k] += double(a.w[i])
+					   * horizontalSum(acc[k]);
+			}
+		}
+	}
+}
+
+__attribute__((target("avx2,fma"))) inline float
+horizontalSumAvx(__m256 v)
+{
+	return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(v),
+					_mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2,fma"))) inline __m256
+distanceSqAvx(const View &b, size_t j, __m256 xi, __m256 yi, __m256 zi)
+{
+	const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(b.x + j), xi);
+	const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(b.y + j), yi);
+	const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(b.z + j), zi);
+	return _mm256_fmadd_ps(dx, dx,
+			       _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+}
+
+__attribute__((target("avx2,fma"))) double
+efficiencySumAvx(const View &a, const View &b, float invR0Sq)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 scale = _mm256_set1_ps(invR0Sq);
+	double sum = 0.0;
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m256 xi = _mm256_set1_ps(a.x[i]);
+			const __m256 yi = _mm256_set1_ps(a.y[i]);
+			const __m256 zi = _mm256_set1_ps(a.z[i]);
+			__m256 acc = _mm256_setzero_ps();
+			for (size_t j = j0; j < j1; j += 8) {
+				const __m256 s = _mm256_mul_ps(
+					distanceSqAvx(b, j, xi, yi, zi), scale);
+				const __m256 s6 = _mm256_fmadd_ps(
+					_mm256_mul_ps(s, s), s, one);
+				acc = _mm256_add_ps(
+					acc,
+					_mm256_div_ps(_mm256_loadu_ps(b.w + j),
+						      s6));
+			}
+			sum += double(a.w[i]) * horizontalSumAvx(acc);
+		}
+	}
+	return sum;
+}
+
+__attribute__((target("avx2,fma"))) double distanceSumAvx(const View &a,
+							   const View &b)
+{
+	double sum = 0.0;
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m256 xi = _mm256_set1_ps(a.x[i]);
+			const __m256 yi = _mm256_set1_ps(a.y[i]);
+			const __m256 zi = _mm256_set1_ps(a.z[i]);
+			__m256 acc = _mm256_setzero_ps();
+			for (size_t j = j0; j < j1; j += 8) {
+				const __m256 r = _mm256_sqrt_ps(
+					distanceSqAvx(b, j, xi, yi, zi));
+				acc = _mm256_fmadd_ps(
+					r, _mm256_loadu_ps(b.w + j), acc);
+			}
+			sum += double(a.w[i]) * horizontalSumAvx(acc);
+		}
+	}
+	return sum;
+}
+
+__attribute__((target("avx2,fma"))) float minDistanceSqAvx(const View &a,
+							    const View &b)
+{
+	__m256 acc = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m256 xi = _mm256_set1_ps(a.x[i]);
+			const __m256 yi = _mm256_set1_ps(a.y[i]);
+			const __m256 zi = _mm256_set1_ps(a.z[i]);
+			for (size_t j = j0; j < j1; j += 8) {
+				acc = _mm256_min_ps(
+					acc, distanceSqAvx(b, j, xi, yi, zi));
+			}
+		}
+	}
+	return horizontalMin(_mm_min_ps(_mm256_castps256_ps128(acc),
+					_mm256_extractf128_ps(acc, 1)));
+}
+
+__attribute__((target("avx2,fma"))) void
+fusedSumsAvx(const View &a, const View &b, const float *invR0Sq, int count,
+	     double *sums)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 scale[maxFused];
+	for (int k = 0; k < count; ++k) {
+		scale[k] = _mm256_set1_ps(invR0Sq[k]);
+	}
+	for (size_t j0 = 0; j0 < b.size; j0 += blockSize) {
+		const size_t j1 = std::min(b.size, j0 + blockSize);
+		for (size_t i = 0; i < a.size; ++i) {
+			const __m256 xi = _mm256_set1_ps(a.x[i]);
+			const __m256 yi = _mm256_set1_ps(a.y[i]);
+			const __m256 zi = _mm256_set1_ps(a.z[i]);
+			__m256 acc[1 + maxFused];
+			for (int k = 0; k <= count; ++k) {
+				acc[k] = _mm256_setzero_ps();
+			}
+			for (size_t j = j0; j < j1; j += 8) {
+				const __m256 rSq =
+					distanceSqAvx(b, j, xi, yi, zi);
+				const __m256 w = _mm256_loadu_ps(b.w + j);
+				acc[0] = _mm256_fmadd_ps(_mm256_sqrt_ps(rSq), w,
+							 acc[0]);
+				for (int k = 0; k < count; ++k) {
+					const __m256 s =
+						_mm256_mul_ps(rSq, scale[k]);
+					const __m256 s6 = _mm256_fmadd_ps(
+						_mm256_mul_ps(s, s), s, one);
+					acc[k + 1] = _mm256_add_ps(
+						acc[k + 1],
+						_mm256_div_ps(w, s6));
+				}
+			}
+			for (int k = 0; k <= count; ++k) {
+				sums[k] += double(a.w[i])
+					   * horizontalSumAvx(acc[k]);
+			}
+		}
+	}
+}
+
+struct Kernels {
+	double (*efficiencySum)(const View &, const View &, float);
+	double (*distanceSum)(const View &, const View &);
+	float (*minDistanceSq)(const View &, const View &);
+	void (*fusedSums)(const View &, const View &, const float *, int,
+			  double *);
+};
+
+// The sums are symmetric, the larger set of points is used for the inner
+// (vectorized) loop. Only the inner loop runs over the padding.
+View outer(const AVPoints &a, const AVPoints &b)
+{
+	const AVPoints &p = b.size() > a.size() ? a : b;
+	return {p.x(), p.y(), p.z(), p.w(), p.size()};
+}
+
+View inner(const AVPoints &a, const AVPoints &b)
+{
+	const AVPoints &p = b.size() > a.size() ? b : a;
+	return {p.x(), p.y(), p.z(), p.w(), p.paddedSize()};
+}
+
+const Kernels &kernels()
+{
+	// selected once, by the features of the CPU the program runs on
+	static const Kernels k =
+		__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+			? Kernels{efficiencySumAvx, distanceSumAvx,
+				  minDistanceSqAvx, fusedSumsAvx}
+			: Kernels{efficiencySumSse, distanceSumSse,
+				  minDistanceSqSse, fusedSumsSse};
+	return k;
+}
+} // namespace
+
+// definitions of the ODR-used constants, required before C++17
+constexpr int AVPoints::width;
+constexpr size_t AVPoints::sampleBatch;
+constexpr size_t AVPoints::minSamples;
+
+AVPoints::AVPoints(const std::vector<Eigen::Vector4f> &points)
+    : _size(points.size())
+{
+	const size_t padded = (_size + width - 1) / width * width;
+	_x.assign(padded, farAway);
+	_y.assign(padded, farAway);
+	_z.assign(padded, farAway);
+	_w.assign(padded, 0.0f);
+	for (size_t i = 0; i < _size; ++i) {
+		_x[i] = points[i][0];
+		_y[i] = points[i][1];
+		_z[i] = points[i][2];
+		_w[i] = points[i][3];
+		_totalW += points[i][3];
+	}
+
+	// alias table (Vose's method) for sample()
+	_aliasCut.assign(_size, std::numeric_limits<std::uint32_t>::max());
+	_alias.resize(_size);
+	std::vector<double> p(_size, 1.0);
+	std::vector<std::uint32_t> small, large;
+	for (size_t i = 0; i < _size; ++i) {
+		_alias[i] = i;
+		if (_totalW > 0.0) {
+			p[i] = _w[i] * _size / _totalW;
+		}
+		(p[i] < 1.0 ? small : large).push_back(i);
+	}
+	while (!small.empty() && !large.empty()) {
+		const std::uint32_t s = small.back(), l = large.back();
+		small.pop_back();
+		_aliasCut[s] = std::uint32_t(p[s] * 4294967296.0);
+		_alias[s] = l;
+		p[l] -= 1.0 - p[s];
+		if (p[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// the rest has p==1 up to the rounding, it is never replaced by an
+	// alias (_alias[i]==i)
+}
+
+double AVPoints::efficiencySum(const AVPoints &other, double R0) const
+{
+	return kernels().efficiencySum(outer(*this, other), inner(*this, other),
+				       float(1.0 / (R0 * R0)));
+}
+
+double AVPoints::distanceSum(const AVPoints &other) const
+{
+	return kernels().distanceSum(outer(*this, other), inner(*this, other));
+}
+
+std::vector<double> AVPoints::pairSums(const AVPoints &other,
+				      const std::vector<double> &R0s) const
+{
+	// up to maxFused radii per pass, the distance from the first one
+	std::vector<double> sums(1 + R0s.size(), 0.0);
+	size_t k0 = 0;
+	do {
+		const int count = std::min<size_t>(maxFused, R0s.size() - k0);
+		float invR0Sq[maxFused];
+		double passSums[1 + maxFused] = {};
+		for (int k = 0; k < count; ++k) {
+			invR0Sq[k] = float(1.0 / (R0s[k0 + k] * R0s[k0 + k]));
+		}
+		kernels().fusedSums(outer(*this, other), inner(*this, other),
+				    invR0Sq, count, passSums);
+		if (k0 == 0) {
+			sums[0] = passSums[0];
+		}
+		std::copy(passSums + 1, passSums + 1 + count,
+			  sums.begin() + 1 + k0);
+		k0 += count;
+	} while (k0 < R0s.size());
+	return sums;
+}
+
+float AVPoints::minDistanceSq(const AVPoints &other) const
+{
+	if (_size == 0 || other._size == 0) {
+		return std::numeric_limits<float>::infinity();
+	}
+	return kernels().minDistanceSq(outer(*this, other),
+				       inner(*this, other));
+}
+
+double AVPoints::sampledEfficiency(const AVPoints &other, double R0,
+				   size_t maxSamples, std::uint64_t seed,
+				   double tolerance) const
+{
+	const float invR0Sq = float(1.0 / (R0 * R0));
+	return sampledMean(
+		other, maxSamples, seed,
+		[invR0Sq](float rSq) { return efficiency(rSq, invR0Sq); },
+		[tolerance](double /*mean*/, double error) {
+			return error < tolerance;
+		});
+}
+
+double AVPoints::sampledDistance(const AVPoints &other, size_t maxSamples,
+				 std::uint64_t seed, double tolerance) const
+{
+	return sampledMean(
+		other, maxSamples, seed,
+		[](float rSq) { return std::sqrt(rSq); },
+		[tolerance](double /*mean*/, double error) {
+			return error < tolerance;
+		});
+}
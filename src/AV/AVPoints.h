@@ -0,0 +1,189 @@
+#ifndef AVPOINTS_H
+#define AVPOINTS_H
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Counter based random numbers: the k-th number of the stream only depends
+// on seed and k (SplitMix64 finalizer applied to seed+k*golden ratio), so
+// samples can be drawn in any order or in parallel with the same result.
+inline std::uint64_t splitMix64(std::uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+inline std::uint64_t counterRandom(std::uint64_t seed, std::uint64_t k)
+{
+	return splitMix64(seed + (k + 1) * 0x9e3779b97f4a7c15ull);
+}
+
+// Points of an AV in structure-of-arrays layout (separate x, y, z and
+// weight arrays), for the pairwise sums over all points of two AVs. The
+// arrays are padded with zero weight points far away, so that the kernels
+// always process whole SIMD registers. The kernels work on the squared
+// distances and use AVX2 if the CPU supports it, SSE otherwise.
+class AVPoints
+{
+public:
+	AVPoints() = default;
+	explicit AVPoints(const std::vector<Eigen::Vector4f> &points);
+
+	size_t size() const
+	{
+		return _size;
+	}
+	// number of points including the padding, a multiple of width
+	size_t paddedSize() const
+	{
+		return _x.size();
+	}
+	const float *x() const
+	{
+		return _x.data();
+	}
+	const float *y() const
+	{
+		return _y.data();
+	}
+	const float *z() const
+	{
+		return _z.data();
+	}
+	const float *w() const
+	{
+		return _w.data();
+	}
+	// sum of the weights
+	double totalWeight() const
+	{
+		return _totalW;
+	}
+	// sum of w1*w2/(1+(r/R0)^6) over all pairs of points
+	double efficiencySum(const AVPoints &other, double R0) const;
+	// sum of w1*w2*r over all pairs of points
+	double distanceSum(const AVPoints &other) const;
+	// sum of w1*w2*r followed by the sums of w1*w2/(1+(r/R0)^6) for each
+	// of R0s, in one pass over all pairs of points
+	std::vector<double> pairSums(const AVPoints &other,
+				     const std::vector<double> &R0s) const;
+	// smallest squared distance between the points, inf if one is empty
+	float minDistanceSq(const AVPoints &other) const;
+
+	// Monte-Carlo estimates of the weighted means of the efficiency and
+	// of the distance over the pairs of points, see sampledMean(). With
+	// tolerance>0 the sampling stops as soon as the standard error of the
+	// estimate is below tolerance.
+	double sampledEfficiency(const AVPoints &other, double R0,
+				 size_t maxSamples, std::uint64_t seed,
+				 double tolerance = 0.0) const;
+	double sampledDistance(const AVPoints &other, size_t maxSamples,
+			       std::uint64_t seed,
+			       double tolerance = 0.0) const;
+
+	// FRET efficiency at the squared distance rSq, invR0Sq=1/R0^2
+	static float efficiency(float rSq, float invR0Sq)
+	{
+		const float s = rSq * invR0Sq;
+		return 1.0f / (1.0f + s * s * s);
+	}
+
+	// Weighted mean of value(rSq) over the pairs of points. Random pairs
+	// are drawn in batches, until done(mean, standardError) returns true
+	// (checked after minSamples) or maxSamples pairs are drawn.
+	template <typename Value, typename Done>
+	double sampledMean(const AVPoints &other, size_t maxSamples,
+			   std::uint64_t seed, Value &&value, Done &&done) const
+	{
+		double mean = 0.0, m2 = 0.0;
+		size_t count = 0;
+		auto batch = [&](const float *rSq, size_t n) {
+			// batch statistics, merged with the running ones
+			float v[sampleBatch];
+			double batchMean = 0.0, batchM2 = 0.0;
+			for (size_t k = 0; k < n; ++k) {
+				v[k] = value(rSq[k]);
+				batchMean += v[k];
+			}
+			batchMean /= n;
+			for (size_t k = 0; k < n; ++k) {
+				const double d = v[k] - batchMean;
+				batchM2 += d * d;
+			}
+			const double delta = batchMean - mean;
+			const double total = count + n;
+			mean += delta * n / total;
+			m2 += batchM2 + delta * delta * count * n / total;
+			count += n;
+			if (count < minSamples) {
+				return true;
+			}
+			return !done(mean, std::sqrt(m2 / (count - 1) / count));
+		};
+		forSampledPairs(other, maxSamples, seed, batch);
+		return mean;
+	}
+
+	// Draws up to maxSamples random pairs of points (one of this, one of
+	// other) and passes their squared distances to
+	// func(const float *rSq, size_t n) in batches, until func returns
+	// false. The points are drawn with the probability proportional to
+	// their weights (alias method), so that the pairs have equal weights.
+	// The indices of a batch are generated first and the coordinates are
+	// then gathered in a separate loop. Both sets must not be empty.
+	template <typename Func>
+	void forSampledPairs(const AVPoints &other, size_t maxSamples,
+			     std::uint64_t seed, Func &&func) const
+	{
+		std::uint32_t i1[sampleBatch], i2[sampleBatch];
+		float rSq[sampleBatch];
+		for (size_t k0 = 0; k0 < maxSamples; k0 += sampleBatch) {
+			const size_t n = std::min(sampleBatch, maxSamples - k0);
+			for (size_t k = 0; k < n; ++k) {
+				const std::uint64_t r =
+					counterRandom(seed, k0 + k);
+				i1[k] = sample(r & 0xffffffffu);
+				i2[k] = other.sample(r >> 32);
+			}
+			for (size_t k = 0; k < n; ++k) {
+				const float dx = _x[i1[k]] - other._x[i2[k]];
+				const float dy = _y[i1[k]] - other._y[i2[k]];
+				const float dz = _z[i1[k]] - other._z[i2[k]];
+				rSq[k] = dx * dx + dy * dy + dz * dz;
+			}
+			if (!func(static_cast<const float *>(rSq), n)) {
+				return;
+			}
+		}
+	}
+
+	// number of the points in the padding unit
+	static constexpr int width = 8;
+	// number of the random pairs per batch
+	static constexpr size_t sampleBatch = 256;
+	// adaptive sampling never stops before this many pairs are drawn
+	static constexpr size_t minSamples = 4 * sampleBatch;
+
+private:
+	using Array = std::vector<float, Eigen::aligned_allocator<float>>;
+	size_t _size = 0;
+	double _totalW = 0.0;
+	Array _x, _y, _z, _w;
+
+	// Index of a point, drawn with the probability proportional to its
+	// weight. Multiply-shift maps the 32 random bits to the bucket [0,n),
+	// the remaining fraction decides between the bucket and its alias.
+	std::uint32_t sample(std::uint64_t random32) const
+	{
+		const std::uint64_t product = random32 * _size;
+		const std::uint32_t i = product >> 32;
+		return std::uint32_t(product) < _aliasCut[i] ? i : _alias[i];
+	}
+	std::vector<std::uint32_t> _aliasCut, _alias;
+};
+
+#endif // AVPOINTS_H
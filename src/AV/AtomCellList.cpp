@@ -0,0 +1,136 @@
+#include "AtomCellList.h"
+
+#include <algorithm>
+#include <cmath>
+
+AtomCellList::AtomCellList(const std::vector<Eigen::Vector4f> &xyzR,
+			   float cellSize)
+    : _cellSize(cellSize)
+{
+	using Eigen::Array3f;
+	using Eigen::Array3i;
+	using Eigen::Vector4f;
+	if (xyzR.empty()) {
+		return;
+	}
+	Array3f lo = xyzR[0].head<3>().array();
+	Array3f hi = lo;
+	for (const Vector4f &r : xyzR) {
+		lo = lo.min(r.head<3>().array());
+		hi = hi.max(r.head<3>().array());
+		_maxR = std::max(_maxR, r[3]);
+	}
+	_origin = lo;
+	_dims = ((hi - lo) / _cellSize).cast<int>() + 1;
+	// sparse systems (e.g. a few far away atoms) should not blow up the
+	// number of cells
+	const long maxCells = 8l * xyzR.size() + 64;
+	while (long(_dims[0]) * _dims[1] * _dims[2] > maxCells) {
+		_cellSize *= 2.0f;
+		_dims = ((hi - lo) / _cellSize).cast<int>() + 1;
+	}
+
+	// counting sort of the atoms by cell
+	const int numCells = _dims.prod();
+	std::vector<int> cellOf(xyzR.size());
+	_cellStart.assign(numCells + 1, 0);
+	for (size_t i = 0; i < xyzR.size(); ++i) {
+		const Array3i c = cell(xyzR[i]);
+		cellOf[i] = cellIndex(c[0], c[1], c[2]);
+		++_cellStart[cellOf[i] + 1];
+	}
+	for (int i = 0; i < numCells; ++i) {
+		_cellStart[i + 1] += _cellStart[i];
+	}
+	std::vector<int> pos(_cellStart.begin(), _cellStart.end() - 1);
+	_xyzR.resize(xyzR.size());
+	_index.resize(xyzR.size());
+	for (size_t i = 0; i < xyzR.size(); ++i) {
+		const int sorted = pos[cellOf[i]]++;
+		_xyzR[sorted] = xyzR[i];
+		_index[sorted] = i;
+	}
+}
+
+Eigen::Array3i AtomCellList::cell(const Eigen::Vector4f &r) const
+{
+	Eigen::Array3i c =
+		((r.head<3>().array() - _origin) / _cellSize).cast<int>();
+	return c.max(0).min(_dims - 1);
+}
+
+template <typename Func>
+void AtomCellList::forCells(const Eigen::Vector3f &center, float radius,
+			    Func &&func) const
+{
+	if (_xyzR.empty() || !center.allFinite()) {
+		return;
+	}
+	const Eigen::Array3f lo =
+		(center.array() - radius - _origin) / _cellSize;
+	const Eigen::Array3f hi =
+		(center.array() + radius - _origin) / _cellSize;
+	if ((hi < 0.0f).any() || (lo >= _dims.cast<float>()).any()) {
+		return;
+	}
+	const Eigen::Array3i cLo = lo.floor().cast<int>().max(0);
+	const Eigen::Array3i cHi = hi.floor().cast<int>().min(_dims - 1);
+	for (int z = cLo[2]; z <= cHi[2]; ++z) {
+		for (int y = cLo[1]; y <= cHi[1]; ++y) {
+			// cells along x are contiguous
+			const int from = _cellStart[cellIndex(cLo[0], y, z)];
+			const int to = _cellStart[cellIndex(cHi[0], y, z) + 1];
+			for (int i = from; i < to; ++i) {
+				if (!func(i)) {
+					return;
+				}
+			}
+		}
+	}
+}
+
+std::vector<Eigen::Vector4f>
+AtomCellList::within(const Eigen::Vector3f &center, float radius,
+		     const std::vector<bool> &stripped) const
+{
+	std::vector<Eigen::Vector4f> atoms;
+	const float radiusSq = radius * radius;
+	const size_t numStripped = stripped.size();
+	forCells(center, radius, [&](int i) {
+		const Eigen::Vector4f &r = _xyzR[i];
+		if ((r.head<3>() - center).squaredNorm() >= radiusSq) {
+			return true;
+		}
+		if (size_t(_index[i]) >= numStripped || !stripped[_index[i]]) {
+			atoms.push_back(r);
+		}
+		return true;
+	});
+	return atoms;
+}
+
+std::vector<int> AtomCellList::indicesWithin(const Eigen::Vector3f &center,
+					     float radius) const
+{
+	std::vector<int> indices;
+	const float radiusSq = radius * radius;
+	forCells(center, radius, [&](int i) {
+		if ((_xyzR[i].head<3>() - center).squaredNorm() < radiusSq) {
+			indices.push_back(_index[i]);
+		}
+		return true;
+	});
+	return indices;
+}
+
+bool AtomCellList::anyWithin(const Eigen::Vector3f &center,
+			     float radius) const
+{
+	bool found = false;
+	const float radiusSq = radius * radius;
+	forCells(center, radius, [&](int i) {
+		found = (_xyzR[i].head<3>() - center).squaredNorm() < radiusSq;
+		return !found;
+	});
+	return found;
+}
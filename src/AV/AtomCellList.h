@@ -0,0 +1,76 @@
+#ifndef ATOMCELLLIST_H
+#define ATOMCELLLIST_H
+
+#include <Eigen/Dense>
+
+#include <string>
+#include <vector>
+
+// Uniform grid (cell list) over the atoms of a frame. Atoms are stored
+// sorted by cell, so that all atoms near a given point can be collected by
+// visiting only the cells, overlapped by the query sphere.
+// Built once per frame and shared by all labeling positions of this frame.
+class AtomCellList
+{
+public:
+	AtomCellList() = default;
+	// xyzR: x,y,z and v.d.Waals radius of each atom
+	explicit AtomCellList(const std::vector<Eigen::Vector4f> &xyzR,
+			      float cellSize = 10.0f);
+
+	size_t size() const
+	{
+		return _xyzR.size();
+	}
+	bool empty() const
+	{
+		return _xyzR.empty();
+	}
+	float maxRadius() const
+	{
+		return _maxR;
+	}
+	// atoms, which are closer than radius to the center, except for the
+	// atoms i with stripped[i]==true (index in the xyzR of the constructor)
+	std::vector<Eigen::Vector4f>
+	within(const Eigen::Vector3f &center, float radius,
+	       const std::vector<bool> &stripped = {}) const;
+	// indices (in the xyzR of the constructor) of the atoms, which are
+	// closer than radius to the center
+	std::vector<int> indicesWithin(const Eigen::Vector3f &center,
+				       float radius) const;
+	// same, but only checks if there is any
+	bool anyWithin(const Eigen::Vector3f &center, float radius) const;
+
+private:
+	// calls func(i) for the atoms _xyzR[i] in the cells, overlapped by the
+	// sphere, until it returns false
+	template <typename Func>
+	void forCells(const Eigen::Vector3f &center, float radius,
+		      Func &&func) const;
+	int cellIndex(int x, int y, int z) const
+	{
+		return x + _dims[0] * (y + _dims[1] * z);
+	}
+	Eigen::Array3i cell(const Eigen::Vector4f &r) const;
+
+	float _cellSize = 10.0f;
+	float _maxR = 0.0f;
+	Eigen::Array3f _origin = Eigen::Array3f::Zero();
+	Eigen::Array3i _dims = Eigen::Array3i::Zero();
+	// atoms of cell i are _xyzR[_cellStart[i]] ... _xyzR[_cellStart[i+1]-1]
+	std::vector<int> _cellStart;
+	std::vector<Eigen::Vector4f> _xyzR;
+	// index of _xyzR[i] in the xyzR of the constructor
+	std::vector<int> _index;
+};
+
+namespace std
+{
+inline std::string to_string(const AtomCellList &atoms)
+{
+	return "atoms:" + std::to_string(atoms.size());
+}
+} // namespace std
+
+#endif // ATOMCELLLIST_H
@@ -28,11 +28,20 @@ public:
 	std::string position1() const;
 	std::string position2() const;
 	double modelDistance(const PositionSimulationResult &pos1,
-			     const PositionSimulationResult &pos2) const;
+			     const PositionSimulationResult &pos2,
+			     std::uint64_t seed = 0,
+			     double tolerance = 0.0) const;
+	// see PositionSimulationResult::approxModelDistance()
+	BoundedValue approxModelDistance(const PositionSimulationResult &pos1,
+					 const PositionSimulationResult &pos2,
+					 double tolerance) const;
+	// Rmp of the AVs, at which the model distance is targetModelDist, see
+	// RmpConverter
 	double RmpFromModelDistance(const PositionSimulationResult &av1,
-				    PositionSimulationResult av2,
+				    const PositionSimulationResult &av2,
 				    const double targetModelDist,
 				    const double accuracy = 0.5) const;
+	// linear fit, for the restraints without the AVs
 	double RmpFromModelDistance() const
 	{
 		// TODO:hack
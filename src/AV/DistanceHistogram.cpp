@@ -0,0 +1,231 @@
+#include "DistanceHistogram.h"
+
+#include <cmath>
+#include <complex>
+
+#include <unsupported/Eigen/FFT>
+
+LatticeDensity::LatticeDensity(const std::vector<Eigen::Vector4f> &points,
+			       float step)
+    : _step(step)
+{
+	using Eigen::Array3i;
+	using Eigen::Vector3d;
+	if (points.empty() || !(step > 0.0f)) {
+		return;
+	}
+	// lattice indices relative to the first point
+	const Vector3d ref = points[0].head<3>().cast<double>();
+	std::vector<Array3i> indices(points.size());
+	Array3i lo = Array3i::Zero(), hi = Array3i::Zero();
+	for (size_t i = 0; i < points.size(); ++i) {
+		const Vector3d r =
+			(points[i].head<3>().cast<double>() - ref) / _step;
+		const Vector3d rounded = r.array().round().matrix();
+		if ((r - rounded).cwiseAbs().maxCoeff() > 0.01) {
+			return;
+		}
+		indices[i] = rounded.cast<int>().array();
+		lo = lo.min(indices[i]);
+		hi = hi.max(indices[i]);
+	}
+	_origin = ref + lo.cast<double>().matrix() * _step;
+	_dims = hi - lo + 1;
+	_weights.assign(long(_dims[0]) * _dims[1] * _dims[2], 0.0);
+	for (size_t i = 0; i < points.size(); ++i) {
+		const Array3i c = indices[i] - lo;
+		const long voxel =
+			c[2] + _dims[2] * (c[1] + long(_dims[1]) * c[0]);
+		_weights[voxel] += points[i][3];
+	}
+	_valid = true;
+}
+
+long LatticeDensity::nearestVoxel(const Eigen::Vector3f &r) const
+{
+	const Eigen::Array3d c =
+		((r.cast<double>() - _origin) / _step).array().round();
+	if (!_valid || (c < 0.0).any() || (c >= _dims.cast<double>()).any()) {
+		return -1;
+	}
+	return long(c[2]) + _dims[2] * (long(c[1]) + long(_dims[1]) * c[0]);
+}
+
+bool LatticeDensity::interior(long voxel) const
+{
+	const int z = voxel % _dims[2];
+	const int y = voxel / _dims[2] % _dims[1];
+	const int x = voxel / _dims[2] / _dims[1];
+	if (x == 0 || y == 0 || z == 0 || x == _dims[0] - 1
+	    || y == _dims[1] - 1 || z == _dims[2] - 1) {
+		return false;
+	}
+	const long stride = long(_dims[1]) * _dims[2];
+	for (int dx = -1; dx <= 1; ++dx) {
+		for (int dy = -1; dy <= 1; ++dy) {
+			const long row = voxel + dx * stride + dy * _dims[2];
+			for (int dz = -1; dz <= 1; ++dz) {
+				if (!(_weights[row + dz] > 0.0)) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool LatticeDensity::occupiedNear(
+	const std::vector<Eigen::Vector4f> &points) const
+{
+	for (const Eigen::Vector4f &point : points) {
+		const long voxel = nearestVoxel(point.head<3>());
+		if (voxel >= 0 && _weights[voxel] > 0.0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+namespace
+{
+int fftSize(int n)
+{
+	// smallest 2^a*3^b*5^c>=n, fast for kissfft
+	for (int size = n;; ++size) {
+		int m = size;
+		for (const int f : {2, 3, 5}) {
+			while (m % f == 0) {
+				m /= f;
+			}
+		}
+		if (m == 1) {
+			return size;
+		}
+	}
+}
+
+Eigen::Array3i correlationDims(const LatticeDensity &a,
+			       const LatticeDensity &b)
+{
+	// large enough for the circular correlation not to wrap around
+	const Eigen::Array3i n = a.dims() + b.dims() - 1;
+	return {fftSize(n[0]), fftSize(n[1]), fftSize(n[2])};
+}
+
+using Complex = std::complex<double>;
+
+void fft3d(std::vector<Complex> &data, const Eigen::Array3i &dims,
+	   bool inverse)
+{
+	// 1D transforms along each of the axes, a line along the axis starts
+	// at outer*stride*n+inner
+	Eigen::FFT<double> fft;
+	const long size = data.size();
+	std::vector<Complex> line, out;
+	long stride = size;
+	for (int axis = 0; axis < 3; ++axis) {
+		const int n = dims[axis];
+		stride /= n;
+		line.resize(n);
+		out.resize(n);
+		for (long outer = 0; outer < size; outer += stride * n) {
+			for (long inner = 0; inner < stride; ++inner) {
+				Complex *first = data.data() + outer + inner;
+				for (int i = 0; i < n; ++i) {
+					line[i] = first[i * stride];
+				}
+				if (inverse) {
+					fft.inv(out.data(), line.data(), n);
+				} else {
+					fft.fwd(out.data(), line.data(), n);
+				}
+				for (int i = 0; i < n; ++i) {
+					first[i * stride] = out[i];
+				}
+			}
+		}
+	}
+}
+} // namespace
+
+long latticeCorrelationSize(const LatticeDensity &a, const LatticeDensity &b)
+{
+	return correlationDims(a, b).cast<long>().prod();
+}
+
+std::vector<double> latticeDistanceHistogram(const LatticeDensity &a,
+					     const LatticeDensity &b,
+					     double distMin, double binSize,
+					     int numBins)
+{
+	using Eigen::Array3i;
+	std::vector<double> hist(numBins, 0.0);
+	if (!a.valid() || !b.valid()) {
+		return hist;
+	}
+	const Array3i dims = correlationDims(a, b);
+	auto index = [&dims](int x, int y, int z) {
+		return z + dims[2] * (y + long(dims[1]) * x);
+	};
+
+	// both real grids are transformed at once as z=a+i*b
+	std::vector<Complex> grid(dims.cast<long>().prod());
+	for (const LatticeDensity *d : {&a, &b}) {
+		const Complex unit = d == &a ? Complex(1.0, 0.0)
+					     : Complex(0.0, 1.0);
+		const Array3i &n = d->dims();
+		const double *w = d->weights().data();
+		for (int x = 0; x < n[0]; ++x) {
+			for (int y = 0; y < n[1]; ++y) {
+				for (int z = 0; z < n[2]; ++z, ++w) {
+					grid[index(x, y, z)] += *w * unit;
+				}
+			}
+		}
+	}
+	fft3d(grid, dims, false);
+
+	// A(f)=(Z(f)+conj(Z(-f)))/2, B(f)=(Z(f)-conj(Z(-f)))/2i, the
+	// cross-correlation c(k)=sum_i a(i+k)*b(i) is the inverse transform
+	// of A(f)*conj(B(f))
+	std::vector<Complex> product(grid.size());
+	for (int x = 0; x < dims[0]; ++x) {
+		const int mx = (dims[0] - x) % dims[0];
+		for (int y = 0; y < dims[1]; ++y) {
+			const int my = (dims[1] - y) % dims[1];
+			for (int z = 0; z < dims[2]; ++z) {
+				const int mz = (dims[2] - z) % dims[2];
+				const Complex zf = grid[index(x, y, z)];
+				const Complex zm =
+					std::conj(grid[index(mx, my, mz)]);
+				const Complex fa = (zf + zm) * 0.5;
+				const Complex fb =
+					(zf - zm) * Complex(0.0, -0.5);
+				product[index(x, y, z)] = fa * std::conj(fb);
+			}
+		}
+	}
+	fft3d(product, dims, true);
+
+	// c(k) is the weight of the displacement origin(a)-origin(b)+k*step,
+	// negative k are wrapped around
+	const Eigen::Vector3d offset = a.origin() - b.origin();
+	const Array3i &na = a.dims();
+	for (int x = 0; x < dims[0]; ++x) {
+		const int kx = x < na[0] ? x : x - dims[0];
+		for (int y = 0; y < dims[1]; ++y) {
+			const int ky = y < na[1] ? y : y - dims[1];
+			for (int z = 0; z < dims[2]; ++z) {
+				const int kz = z < na[2] ? z : z - dims[2];
+				const Eigen::Vector3d k(kx, ky, kz);
+				const double r = (offset + a.step() * k).norm();
+				const double bin = (r - distMin) / binSize;
+				if (bin >= 0.0 && bin < numBins) {
+					hist[int(bin)] +=
+						product[index(x, y, z)].real();
+				}
+			}
+		}
+	}
+	return hist;
+}
@@ -0,0 +1,68 @@
+#ifndef DISTANCEHISTOGRAM_H
+#define DISTANCEHISTOGRAM_H
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+// Weights of AV points, which lie on a cubic lattice (as produced by the AV
+// simulation: source position + integer multiples of the grid step),
+// stored on a dense grid over their bounding box.
+class LatticeDensity
+{
+public:
+	LatticeDensity() = default;
+	// The density is invalid (valid()==false), if the points do not lie
+	// on a lattice with the given step.
+	LatticeDensity(const std::vector<Eigen::Vector4f> &points, float step);
+	bool valid() const
+	{
+		return _valid;
+	}
+	// position of the voxel (0,0,0)
+	const Eigen::Vector3d &origin() const
+	{
+		return _origin;
+	}
+	const Eigen::Array3i &dims() const
+	{
+		return _dims;
+	}
+	double step() const
+	{
+		return _step;
+	}
+	// weight of the voxel (x,y,z), index z+dims[2]*(y+dims[1]*x)
+	const std::vector<double> &weights() const
+	{
+		return _weights;
+	}
+	// index of the voxel nearest to r, -1 if it is outside of the grid
+	long nearestVoxel(const Eigen::Vector3f &r) const;
+	// whether the voxel and all of its 26 neighbours have weight>0
+	bool interior(long voxel) const;
+	// whether the voxel nearest to any of the points has weight>0
+	bool occupiedNear(const std::vector<Eigen::Vector4f> &points) const;
+
+private:
+	bool _valid = false;
+	double _step = 0.0;
+	Eigen::Vector3d _origin = Eigen::Vector3d::Zero();
+	Eigen::Array3i _dims = Eigen::Array3i::Zero();
+	std::vector<double> _weights;
+};
+
+// Exact weighted histogram of the distances between all pairs of points
+// (sum of w1*w2 per bin, bin i covers [distMin+i*binSize,
+// distMin+(i+1)*binSize)). The two densities must have the same step. The
+// pair weights for every displacement between the lattices are obtained by
+// cross-correlation of the density grids with FFT.
+std::vector<double> latticeDistanceHistogram(const LatticeDensity &a,
+					     const LatticeDensity &b,
+					     double distMin, double binSize,
+					     int numBins);
+// number of grid points of the cross-correlation, its cost is about
+// proportional to n*log2(n)
+long latticeCorrelationSize(const LatticeDensity &a, const LatticeDensity &b);
+
+#endif // DISTANCEHISTOGRAM_H
@@ -0,0 +1,126 @@
+#include "OccupancyGrid.h"
+
+#include <algorithm>
+
+SphereStamp::SphereStamp(int radius) : _radius(radius)
+{
+	// same voxels as dx*dx+dy*dy+dz*dz<=radius*radius
+	const int maxSq = radius * radius;
+	for (int dx = -radius; dx <= radius; ++dx) {
+		for (int dy = -radius; dy <= radius; ++dy) {
+			const int rem = maxSq - dx * dx - dy * dy;
+			if (rem < 0) {
+				continue;
+			}
+			int hw = 0;
+			while ((hw + 1) * (hw + 1) <= rem) {
+				++hw;
+			}
+			_runs.push_back({dx, dy, hw});
+		}
+	}
+	_runs.shrink_to_fit();
+}
+
+void OccupancyGrid::reset(int edgeL)
+{
+	_edgeL = edgeL;
+	_rowWords = (edgeL + rowPadding + wordBits - 1) / wordBits;
+	const size_t numWords = size_t(_rowWords) * edgeL * edgeL;
+	// keep the capacity, when the grid is reused
+	_words.assign(numWords, 0u);
+	if (edgeL == 0) {
+		return;
+	}
+	const int padFrom = edgeL % wordBits;
+	const long lastWord = (edgeL - 1) / wordBits;
+	for (long row = 0; row < long(edgeL) * edgeL; ++row) {
+		word_t *rowWords = _words.data() + row * _rowWords;
+		if (padFrom) {
+			rowWords[lastWord] |= mask(padFrom, wordBits - 1);
+		}
+		for (long w = lastWord + 1; w < _rowWords; ++w) {
+			rowWords[w] = ~word_t(0);
+		}
+	}
+}
+
+bool OccupancyGrid::anyInRun(int x, int y, int z0, int z1) const
+{
+	if (!clip(x, y, z0, z1)) {
+		return false;
+	}
+	const long b0 = bit(x, y, z0);
+	const long b1 = b0 + (z1 - z0);
+	const long w0 = b0 / wordBits, w1 = b1 / wordBits;
+	const int o0 = b0 % wordBits, o1 = b1 % wordBits;
+	if (w0 == w1) {
+		return _words[w0] & mask(o0, o1);
+	}
+	if (_words[w0] & mask(o0, wordBits - 1)) {
+		return true;
+	}
+	for (long w = w0 + 1; w < w1; ++w) {
+		if (_words[w]) {
+			return true;
+		}
+	}
+	return _words[w1] & mask(0, o1);
+}
+
+void OccupancyGrid::fill(const SphereStamp &stamp, int x, int y, int z)
+{
+	for (const SphereStamp::Run &run : stamp.runs()) {
+		setRun(x + run.dx, y + run.dy, z - run.halfWidth,
+		       z + run.halfWidth);
+	}
+}
+
+void OccupancyGrid::fill(const SphereStamp &stamp, int x, int y, int z,
+			 int xBegin, int xEnd)
+{
+	for (const SphereStamp::Run &run : stamp.runs()) {
+		const int rx = x + run.dx;
+		if (rx >= xBegin && rx < xEnd) {
+			setRun(rx, y + run.dy, z - run.halfWidth,
+			       z + run.halfWidth);
+		}
+	}
+}
+
+void OccupancyGrid::clear(const SphereStamp &stamp, int x, int y, int z)
+{
+	for (const SphereStamp::Run &run : stamp.runs()) {
+		clearRun(x + run.dx, y + run.dy, z - run.halfWidth,
+			 z + run.halfWidth);
+	}
+}
+
+bool OccupancyGrid::any(const SphereStamp &stamp, int x, int y, int z) const
+{
+	return std::any_of(stamp.runs().begin(), stamp.runs().end(),
+			   [&](const SphereStamp::Run &run) {
+				   return anyInRun(x + run.dx, y + run.dy,
+						   z - run.halfWidth,
+						   z + run.halfWidth);
+			   });
+}
+
+void OccupancyGrid::differences(const OccupancyGrid &other,
+				std::vector<int> &indexes) const
+{
+	indexes.clear();
+	const long pitchBits = pitch();
+	for (size_t w = 0; w < _words.size(); ++w) {
+		word_t diff = _words[w] ^ other._words[w];
+		while (diff) {
+			const long b = long(w) * wordBits + __builtin_ctzll(diff);
+			diff &= diff - 1u;
+			const long row = b / pitchBits;
+			const int z = b % pitchBits;
+			if (z < _edgeL) {
+				indexes.push_back(row * _edgeL + z);
+			}
+		}
+	}
+}
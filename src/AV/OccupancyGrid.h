@@ -0,0 +1,177 @@
+#ifndef OCCUPANCYGRID_H
+#define OCCUPANCYGRID_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sphere of integer radius on a cubic grid, stored as a list of runs along
+// the z axis. Every (dx,dy) column of the sphere is a single contiguous
+// run of voxels [-halfWidth, halfWidth], so a sphere can be stamped into
+// an OccupancyGrid row by row with a few word-wide bit operations.
+class SphereStamp
+{
+public:
+	struct Run {
+		int dx, dy, halfWidth;
+	};
+	SphereStamp() = default;
+	explicit SphereStamp(int radius);
+	int radius() const
+	{
+		return _radius;
+	}
+	const std::vector<Run> &runs() const
+	{
+		return _runs;
+	}
+
+private:
+	int _radius = -1;
+	std::vector<Run> _runs;
+};
+
+// Cubic bitset grid with word-aligned rows. Voxel (x,y,z) is stored in bit
+// z of row x*edgeL+y, each row occupies a whole number of 64-bit words.
+// At least rowPadding bits past the end of a row (z>=edgeL) exist and are
+// kept set, so that neighbour lookups which run over the row end see an
+// obstacle instead of the beginning of the next row.
+class OccupancyGrid
+{
+public:
+	using word_t = std::uint64_t;
+	static constexpr int wordBits = 64;
+	static constexpr int rowPadding = 3;
+
+	OccupancyGrid() = default;
+	explicit OccupancyGrid(int edgeL)
+	{
+		reset(edgeL);
+	}
+	void reset(int edgeL);
+
+	int edgeL() const
+	{
+		return _edgeL;
+	}
+	// number of voxels
+	size_t size() const
+	{
+		return size_t(_edgeL) * _edgeL * _edgeL;
+	}
+	// distance between the rows in bits
+	long pitch() const
+	{
+		return _rowWords * wordBits;
+	}
+	long bit(int x, int y, int z) const
+	{
+		return (long(x) * _edgeL + y) * pitch() + z;
+	}
+	// bit offset of the voxel (dx,dy,dz) relative to the current one
+	long bitOffset(int dx, int dy, int dz) const
+	{
+		return (long(dx) * _edgeL + dy) * pitch() + dz;
+	}
+	// bit index of the voxel with the dense index z+edgeL*(y+x*edgeL)
+	long bitFromIndex(int i) const
+	{
+		return long(i / _edgeL) * pitch() + i % _edgeL;
+	}
+	bool test(long bit) const
+	{
+		return (_words[bit / wordBits] >> (bit % wordBits)) & 1u;
+	}
+	bool test(int x, int y, int z) const
+	{
+		return test(bit(x, y, z));
+	}
+	void set(int x, int y, int z)
+	{
+		const long b = bit(x, y, z);
+		_words[b / wordBits] |= word_t(1) << (b % wordBits);
+	}
+
+	// set/clear/test the voxels z0..z1 (inclusive) of the row (x,y),
+	// the run is clipped to the grid
+	void setRun(int x, int y, int z0, int z1)
+	{
+		applyRun<true>(x, y, z0, z1);
+	}
+	void clearRun(int x, int y, int z0, int z1)
+	{
+		applyRun<false>(x, y, z0, z1);
+	}
+	bool anyInRun(int x, int y, int z0, int z1) const;
+
+	// sphere, centered at (x,y,z), the parts outside of the grid are
+	// ignored
+	void fill(const SphereStamp &stamp, int x, int y, int z);
+	// same, but only the rows xBegin<=x<xEnd are modified, so that
+	// distinct x slabs can be filled concurrently
+	void fill(const SphereStamp &stamp, int x, int y, int z, int xBegin,
+		  int xEnd);
+	void clear(const SphereStamp &stamp, int x, int y, int z);
+	bool any(const SphereStamp &stamp, int x, int y, int z) const;
+
+	void fillRow(int x, int y)
+	{
+		setRun(x, y, 0, _edgeL - 1);
+	}
+
+	// dense indices z+edgeL*(y+x*edgeL) of the voxels, which differ from
+	// the ones of the other grid (of the same size)
+	void differences(const OccupancyGrid &other,
+			 std::vector<int> &indexes) const;
+
+private:
+	bool clip(int x, int y, int &z0, int &z1) const
+	{
+		if (x < 0 || y < 0 || x >= _edgeL || y >= _edgeL) {
+			return false;
+		}
+		z0 = z0 < 0 ? 0 : z0;
+		z1 = z1 >= _edgeL ? _edgeL - 1 : z1;
+		return z0 <= z1;
+	}
+	static word_t mask(int from, int to)
+	{
+		// bits from..to (inclusive) of a word
+		const word_t hi = to == wordBits - 1
+					  ? ~word_t(0)
+					  : (word_t(1) << (to + 1)) - 1u;
+		return hi & (~word_t(0) << from);
+	}
+	template <bool value> void applyRun(int x, int y, int z0, int z1)
+	{
+		if (!clip(x, y, z0, z1)) {
+			return;
+		}
+		const long b0 = bit(x, y, z0);
+		const long b1 = b0 + (z1 - z0);
+		long w0 = b0 / wordBits, w1 = b1 / wordBits;
+		const int o0 = b0 % wordBits, o1 = b1 % wordBits;
+		if (w0 == w1) {
+			apply<value>(_words[w0], mask(o0, o1));
+			return;
+		}
+		apply<value>(_words[w0], mask(o0, wordBits - 1));
+		for (long w = w0 + 1; w < w1; ++w) {
+			apply<value>(_words[w], ~word_t(0));
+		}
+		apply<value>(_words[w1], mask(0, o1));
+	}
+	template <bool value> static void apply(word_t &word, word_t m)
+	{
+		if (value) {
+			word |= m;
+		} else {
+			word &= ~m;
+		}
+	}
+
+	int _edgeL = 0;
+	long _rowWords = 0;
+	std::vector<word_t> _words;
+};
+
+#endif // OCCUPANCYGRID_H
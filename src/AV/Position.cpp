@@ -2,10 +2,12 @@
 #include "Distance.h"
 #include "PositionSimulation.h"
 
+#include <cmath>
 #include <map>
 #include <iostream>
 #include <string>
 #include <future>
+#include <unordered_map>
 
 #include <QVariant>
 #include <QJsonDocument>
@@ -99,58 +101,166 @@ QMap<QString, double> loadvdWRadii(const QString &fileName)
 	}
 	return map;
 }
-float pterosVDW(const pteros::System &system, int i)
+std::vector<float> vdWRadii(const pteros::System &system)
 {
 	// TODO: This is a hack. One should define a corresponding function in
 	// pteros::System
-	QString path =
-		QCoreApplication::applicationDirPath() + "/vdWRadii.json";
-	static QMap<QString, double> vdWRMap = loadvdWRadii(path);
-	return vdWRMap.value(QString::fromStdString(system.atom(i).name), 0.15);
+	static const std::unordered_map<std::string, float> vdWRMap = [] {
+		QString path = QCoreApplication::applicationDirPath()
+			       + "/vdWRadii.json";
+		const QMap<QString, double> map = loadvdWRadii(path);
+		std::unordered_map<std::string, float> radii;
+		for (auto it = map.begin(); it != map.end(); ++it) {
+			radii[it.key().toStdString()] = it.value() * 10.0;
+		}
+		return radii;
+	}();
+	const int nAtoms = system.num_atoms();
+	std::vector<float> radii(nAtoms, 1.5f);
+	for (int i = 0; i < nAtoms; ++i) {
+		auto it = vdWRMap.find(system.atom(i).name);
+		if (it != vdWRMap.end()) {
+			radii[i] = it->second;
+		}
+	}
+	return radii;
 }
 
-std::vector<Eigen::Vector4f> coordsVdW(const pteros::System &system)
+std::vector<Eigen::Vector4f>
+coordsVdW(const std::vector<Eigen::Vector3f> &coords,
+	  const std::vector<float> &radii)
 {
 	// iterate over atoms and fill x,y,z,vdw
-	int nAtoms = system.num_atoms();
+	const size_t nAtoms = std::min(coords.size(), radii.size());
 	std::vector<Eigen::Vector4f> xyzw;
 	xyzw.reserve(nAtoms);
-
-	// Fill coordinates
-	const pteros::Frame &frame = system.frame(0);
-	for (int i = 0; i < nAtoms; i++) {
-		xyzw.emplace_back(frame.coord.at(i)[0] * 10.0f,
-				  frame.coord.at(i)[1] * 10.0f,
-				  frame.coord.at(i)[2] * 10.0f,
-				  pterosVDW(system, i) * 10.0f);
+	for (size_t i = 0; i < nAtoms; i++) {
+		xyzw.emplace_back(coords[i][0] * 10.0f, coords[i][1] * 10.0f,
+				  coords[i][2] * 10.0f, radii[i]);
 	}
 	return xyzw;
 }
 
-PositionSimulationResult Position::calculate(const pteros::System &system) const
+std::vector<Eigen::Vector4f> coordsVdW(const pteros::System &system,
+				       const std::vector<float> &radii)
 {
-	std::vector<Eigen::Vector4f> xyzW;
-	Eigen::Vector3f refPos = atomXYZ(system);
-	std::string stripExpr = stripExpression();
-	if (stripExpr.empty()) {
-		xyzW = coordsVdW(system);
-	} else {
-		try {
-			pteros::System stripped = system;
-			pteros::Selection rmSel = stripped.select(stripExpr);
-			if (rmSel.size() > 0) {
-				stripped.remove(stripExpr);
+	return coordsVdW(system.frame(0).coord, radii);
+}
+
+std::vector<Eigen::Vector4f> coordsVdW(const pteros::System &system)
+{
+	return coordsVdW(system, vdWRadii(system));
+}
+
+std::vector<bool> Position::strippedAtoms(const FrameData &frame,
+					  const AtomCellList *atoms,
+					  const std::string &trajectory) const
+{
+	if (_allowedSphereRadius <= 0.0 && _stripMask.empty()) {
+		return {};
+	}
+	const std::vector<Eigen::Vector3f> &coords = frame.coords();
+	const int nAtoms = coords.size();
+	if (atoms && atoms->size() != size_t(nAtoms)) {
+		atoms = nullptr;
+	}
+	std::vector<bool> stripped(nAtoms, false);
+	if (!_stripMask.empty()) {
+		const SelectionCache::Indices mask = _selections.indices(
+			trajectory, frame, _stripMask, atoms);
+		for (int i : *mask) {
+			stripped[i] = true;
+		}
+	}
+	if (_allowedSphereRadius <= 0.0) {
+		return stripped;
+	}
+	// "within radius noself of (selection)": the atoms near the attachment
+	// atom(s), but not the attachment atom(s) themselves
+	const SelectionCache::Indices centers =
+		_selections.indices(trajectory, frame, selectionExpression());
+	const float radius = _allowedSphereRadius;
+	std::vector<bool> near(nAtoms, false);
+	for (int c : *centers) {
+		const Eigen::Vector3f center = coords[c] * 10.0f;
+		if (atoms) {
+			for (int i : atoms->indicesWithin(center, radius)) {
+				near[i] = true;
 			}
-			xyzW = coordsVdW(stripped);
-		} catch (pteros::Pteros_error err) {
-			std::cerr << "stripping failed: "
-					     + std::string(err.what()) + ": '"
-					     + stripExpr + "'\n"
-				  << std::flush;
-			xyzW = coordsVdW(system);
+			continue;
 		}
+		for (int i = 0; i < nAtoms; ++i) {
+			const Eigen::Vector3f r = coords[i] * 10.0f;
+			if ((r - center).squaredNorm() < radius * radius) {
+				near[i] = true;
+			}
+		}
+	}
+	for (int c : *centers) {
+		near[c] = false;
 	}
-	return calculate(refPos, xyzW);
+	for (int i = 0; i < nAtoms; ++i) {
+		stripped[i] = stripped[i] || near[i];
+	}
+	return stripped;
+}
+
+PositionSimulationResult Position::calculate(const FrameData &frame,
+					     const AtomCellList *atoms,
+					     const std::string &trajectory) const
+{
+	Eigen::Vector3f refPos = atomXYZ(frame, trajectory);
+	const float cutoff =
+		atoms && _simulation
+			? _simulation->influenceRadius(atoms->maxRadius())
+			: std::numeric_limits<float>::infinity();
+	if (std::isfinite(cutoff)) {
+		const std::vector<bool> stripped =
+			strippedAtoms(frame, atoms, trajectory);
+		return calculate(refPos,
+				 atoms->within(refPos, cutoff, stripped),
+				 trajectory);
+	}
+	std::vector<Eigen::Vector4f> xyzW =
+		coordsVdW(frame.coords(), vdWRadii(frame.topology()));
+	const std::vector<bool> stripped =
+		strippedAtoms(frame, nullptr, trajectory);
+	if (!stripped.empty()) {
+		size_t kept = 0;
+		for (size_t i = 0; i < xyzW.size(); ++i) {
+			if (!stripped[i]) {
+				xyzW[kept++] = xyzW[i];
+			}
+		}
+		xyzW.resize(kept);
+	}
+	return calculate(refPos, xyzW, trajectory);
+}
+
+PositionSimulationResult Position::calculate(const pteros::System &system,
+					     const std::string &trajectory) const
+{
+	return calculate(FrameData::view(system), nullptr, trajectory);
+}
+
+PositionSimulationResult Position::calculate(const pteros::System &system,
+					     const AtomCellList &atoms,
+					     const std::string &trajectory) const
+{
+	return calculate(FrameData::view(system), &atoms, trajectory);
+}
+
+PositionSimulationResult Position::calculate(const FrameData &frame,
+					     const std::string &trajectory) const
+{
+	return calculate(frame, nullptr, trajectory);
+}
+
+PositionSimulationResult Position::calculate(const FrameData &frame,
+					     const AtomCellList &atoms,
+					     const std::string &trajectory) const
+{
+	return calculate(frame, &atoms, trajectory);
 }
 
 
@@ -327,15 +437,16 @@ std::vector<Position> Position::fromLegacy(const std::string &labelingFileName,
 
 Eigen::Vector3f Position::atomXYZ(const pteros::System &system) const
 {
+	return atomXYZ(FrameData::view(system), "");
+}
 
-	pteros::Selection select;
-	try {
-		select.modify(system, selectionExpression());
-	} catch (const pteros::Pteros_error &err) {
-		std::cerr << err.what() << std::endl;
-	}
+Eigen::Vector3f Position::atomXYZ(const FrameData &frame,
+				  const std::string &trajectory) const
+{
+	const SelectionCache::Indices selected =
+		_selections.indices(trajectory, frame, selectionExpression());
 
-	int selectedCount = select.size();
+	int selectedCount = selected->size();
 
 	if (selectedCount != 1) {
 		std::cerr <<"Position \""+ _name +
@@ -346,14 +457,15 @@ Eigen::Vector3f Position::atomXYZ(const pteros::System &system) const
 		const double nan = std::numeric_limits<float>::quiet_NaN();
 		return Eigen::Vector3f(nan, nan, nan);
 	}
-	return select.xyz(0) * 10.0f;
+	return frame.coords()[selected->front()] * 10.0f;
 }
 
 PositionSimulationResult
 Position::calculate(const Eigen::Vector3f &attachmentAtomPos,
-		    const std::vector<Eigen::Vector4f> &store) const
+		    const std::vector<Eigen::Vector4f> &store,
+		    const std::string &trajectory) const
 {
-	return _simulation->calculate(attachmentAtomPos, store);
+	return _simulation->calculate(attachmentAtomPos, store, trajectory);
 }
 
 void Position::setFromLegacy(const std::string &entry,
@@ -407,22 +519,6 @@ std::string Position::selectionExpression() const
 	return expr;
 }
 
-std::string Position::stripExpression() const
-{
-	if (_allowedSphereRadius <= 0.0) {
-		return _stripMask;
-	}
-	// TODO: should use std::to_chars instead
-	std::string num = std::to_string(_allowedSphereRadius * 0.1);
-	std::replace(num.begin(), num.end(), ',', '.');
-	std::string expr = "(within " + num + " noself of ("
-			   + selectionExpression() + "))";
-	if (!_stripMask.empty()) {
-		expr += " or (" + _stripMask + ")";
-	}
-	return expr;
-}
-
 void Position::setChainIdentifier(const std::string &chainIdentifier)
 {
 	_chainIdentifier = chainIdentifier;
@@ -8,6 +8,9 @@
 #include "PositionSimulationResult.h"
 #include "AbstractEvaluator.h"
 #include "fretAV.h"
+#include "AtomCellList.h"
+#include "SelectionCache.h"
+#include "FrameData.h"
 
 #include <iostream>
 #include <vector>
@@ -56,7 +59,24 @@ public:
 	Position &operator=(Position &&o);
 	Position(const std::string &name);
 
-	PositionSimulationResult calculate(const pteros::System &system) const;
+	// trajectory identifies the sequence of frames, the system belongs to,
+	// incremental simulations reuse the results of its previous frame
+	PositionSimulationResult
+	calculate(const pteros::System &system,
+		  const std::string &trajectory = "") const;
+	// same as above, but takes the atoms (x,y,z,vdW) of the system from
+	// the precomputed cell list and only passes those nearby to the
+	// simulation
+	PositionSimulationResult
+	calculate(const pteros::System &system, const AtomCellList &atoms,
+		  const std::string &trajectory = "") const;
+	// same as above for a frame with a shared topology
+	PositionSimulationResult
+	calculate(const FrameData &frame,
+		  const std::string &trajectory = "") const;
+	PositionSimulationResult
+	calculate(const FrameData &frame, const AtomCellList &atoms,
+		  const std::string &trajectory = "") const;
 
 	std::pair<QString, QVariant> setting(int row) const;
 	void setSetting(int row, const QVariant &val);
@@ -109,10 +129,23 @@ public:
 private:
 	// Eigen::Vector3f atomXYZ(BALL::System &system) const;
 	std::string selectionExpression() const;
-	std::string stripExpression() const;
+	// trajectory is the key of the selections in _selections
+	Eigen::Vector3f atomXYZ(const FrameData &frame,
+				const std::string &trajectory) const;
+	// stripped[i]==true for the atoms i, selected by the strip mask or
+	// within the allowed sphere radius of the attachment atom, empty if
+	// nothing is stripped. The latter are looked up in atoms, if given.
+	std::vector<bool> strippedAtoms(const FrameData &frame,
+					const AtomCellList *atoms,
+					const std::string &trajectory) const;
+	// uses the cell list, if atoms!=nullptr
+	PositionSimulationResult calculate(const FrameData &frame,
+					   const AtomCellList *atoms,
+					   const std::string &trajectory) const;
 	PositionSimulationResult
 	calculate(const Eigen::Vector3f &attachmentAtomPos,
-		  const std::vector<Eigen::Vector4f> &store) const;
+		  const std::vector<Eigen::Vector4f> &store,
+		  const std::string &trajectory) const;
 
 private:
 	std::string _name;
@@ -126,6 +159,20 @@ private:
 	SimulationType _simulationType = SimulationType::AV1;
 	const int _localSettingCount = 8;
 	PositionSimulation *_simulation = nullptr;
+	// the frames of a trajectory share the topology
+	mutable SelectionCache _selections;
 };
 Q_DECLARE_METATYPE(Position::SimulationType)
+
+// v.d.Waals radius of every atom in the system (in Angstroms), depends only
+// on the atom names, i.e. is the same for all frames of a topology
+std::vector<float> vdWRadii(const pteros::System &system);
+// x,y,z and v.d.Waals radius of every atom in the system (in Angstroms)
+std::vector<Eigen::Vector4f> coordsVdW(const pteros::System &system,
+				       const std::vector<float> &radii);
+// same for the coordinates coords (in nm)
+std::vector<Eigen::Vector4f>
+coordsVdW(const std::vector<Eigen::Vector3f> &coords,
+	  const std::vector<float> &radii);
+std::vector<Eigen::Vector4f> coordsVdW(const pteros::System &system);
 #endif // POSITION_H
@@ -1,10 +1,41 @@
 #include "PositionSimulation.h"
 #include "fretAV.h"
 #include "Position.h"
+#include <algorithm>
+
 #include <QTextStream>
 #include <QFile>
+#include <QRegExp>
+#include <QStringList>
 #include <QCoreApplication>
 
+std::unique_lock<std::mutex>
+AVHistoryCache::lock(const std::string &trajectory, AVHistory *&history)
+{
+	Slot *slot = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		std::unique_ptr<Slot> &ptr = _slots[trajectory];
+		if (!ptr) {
+			ptr.reset(new Slot);
+		}
+		slot = ptr.get();
+	}
+	std::unique_lock<std::mutex> lock(slot->mutex, std::try_to_lock);
+	history = lock.owns_lock() ? &slot->history : nullptr;
+	return lock;
+}
+
+void AVHistoryCache::clear()
+{
+	std::lock_guard<std::mutex> guard(_mutex);
+	for (auto &slot : _slots) {
+		// wait for the calculations, which still use the history
+		std::lock_guard<std::mutex> slotGuard(slot.second->mutex);
+	}
+	_slots.clear();
+}
+
 PositionSimulation::PositionSimulation()
 {
 }
@@ -49,12 +80,35 @@ PositionSimulation::Setting PositionSimulationAV3::setting(int row) const
 		return Setting{"contact_volume_thickness", contactR};
 	case 8:
 		return Setting{"contact_volume_trapped_fraction", trappedFrac};
+	case 9:
+		return Setting{"path_length_engine",
+			       QString::fromStdString(pathLengthEngineName(
+				       avOptions.pathEngine))};
+	case 10:
+		return Setting{"occupancy_backend",
+			       QString::fromStdString(occupancyBackendName(
+				       avOptions.occupancyBackend))};
+	case 11:
+		return Setting{"linker_length_sweep",
+			       lengthsString(linkerLengthSweep)};
+	case 12:
+		return Setting{"incremental", incrementalUpdate};
+	case 13:
+		return Setting{"incremental_tolerance", incrementalTolerance};
+	case 14:
+		return Setting{"coarse_grid_factor", avOptions.coarseFactor};
+	case 15:
+		return Setting{"path_stencil",
+			       QString::fromStdString(
+				       pathStencilName(avOptions.stencil))};
 	}
 	return Setting();
 }
 
 void PositionSimulationAV3::setSetting(int row, const QVariant &val)
 {
+	// results of the other settings can not be reused
+	avHistories.clear();
 	switch (row) {
 	case 0:
 		gridResolution = val.toDouble();
@@ -83,12 +137,36 @@ void PositionSimulationAV3::setSetting(int row, const QVariant &val)
 	case 8:
 		trappedFrac = val.toDouble();
 		return;
+	case 9:
+		avOptions.pathEngine =
+			pathLengthEngine(val.toString().toStdString());
+		return;
+	case 10:
+		avOptions.occupancyBackend =
+			occupancyBackend(val.toString().toStdString());
+		return;
+	case 11:
+		linkerLengthSweep = parseLengths(val.toString());
+		return;
+	case 12:
+		incrementalUpdate = val.toBool();
+		return;
+	case 13:
+		incrementalTolerance = val.toDouble();
+		return;
+	case 14:
+		avOptions.coarseFactor = std::max(1, val.toInt());
+		return;
+	case 15:
+		avOptions.stencil = pathStencil(val.toString().toStdString());
+		return;
 	}
 }
 
 PositionSimulationResult
 PositionSimulation::calculate(const Eigen::Vector3f &attachmentAtomPos,
-			      const std::vector<Eigen::Vector4f> &xyzW)
+			      const std::vector<Eigen::Vector4f> &xyzW,
+			      const std::string &trajectory)
 {
 	Eigen::Vector4f v(attachmentAtomPos(0), attachmentAtomPos(1),
 			  attachmentAtomPos(2), 0.0f);
@@ -109,24 +187,111 @@ PositionSimulation::calculate(const Eigen::Vector3f &attachmentAtomPos,
 	// TODO: this is a horrible hack
 	std::vector<Eigen::Vector4f> xyzW2 = xyzW;
 	xyzW2[atom_i][3] = 0.0f;
-	return calculate(atom_i, xyzW2);
+	if (!incremental() || trajectory.empty()) {
+		return calculate(atom_i, xyzW2, nullptr);
+	}
+	AVHistory *history = nullptr;
+	auto lock = avHistories.lock(trajectory, history);
+	return calculate(atom_i, xyzW2, history);
+}
+
+std::vector<double> PositionSimulation::parseLengths(const QString &str)
+{
+	std::vector<double> lengths;
+	const QStringList words =
+		str.split(QRegExp("[\\s,;]+"), QString::SkipEmptyParts);
+	for (const QString &word : words) {
+		bool ok = false;
+		double length = word.toDouble(&ok);
+		if (!ok || length <= 0.0) {
+			std::cerr << "invalid linker length: "
+					     + word.toStdString() + "\n"
+				  << std::flush;
+			continue;
+		}
+		lengths.push_back(length);
+	}
+	return lengths;
+}
+
+QString PositionSimulation::lengthsString(const std::vector<double> &lengths)
+{
+	QStringList words;
+	for (double length : lengths) {
+		words << QString::number(length);
+	}
+	return words.join(' ');
+}
+
+PositionSimulationResult
+PositionSimulation::sweepResult(std::vector<std::vector<Eigen::Vector4f>> &&avs,
+				const std::vector<float> &linkerLengths,
+				double gridResolution,
+				double minVolumeSphereFraction)
+{
+	for (size_t i = 0; i < avs.size(); ++i) {
+		double volfrac =
+			avs[i].size()
+			/ (4.0 / 3.0 * 3.14159
+			   * std::pow(linkerLengths[i] / gridResolution, 3.0));
+		if (minVolumeSphereFraction > volfrac) {
+			avs[i].clear();
+		}
+	}
+	if (avs.empty()) {
+		return PositionSimulationResult();
+	}
+	PositionSimulationResult res(std::move(avs[0]));
+	res.setGridStep(gridResolution);
+	if (avs.size() == 1) {
+		return res;
+	}
+	using Entry = PositionSimulationResult::Sweep::value_type;
+	PositionSimulationResult::Sweep sweep;
+	for (size_t i = 1; i < avs.size(); ++i) {
+		sweep.emplace_back(linkerLengths[i],
+				   PositionSimulationResult(std::move(avs[i])));
+		sweep.back().second.setGridStep(gridResolution);
+	}
+	std::stable_sort(sweep.begin(), sweep.end(),
+			 [](const Entry &l, const Entry &r) {
+				 return l.first < r.first;
+			 });
+	res.setSweep(std::move(sweep));
+	return res;
 }
 
 PositionSimulationResult
 PositionSimulationAV3::calculate(unsigned atom_i,
-				 const std::vector<Eigen::Vector4f> &xyzW)
+				 const std::vector<Eigen::Vector4f> &xyzW,
+				 AVHistory *history)
+{
+	if (history) {
+		history->tolerance = incrementalTolerance;
+	}
+	std::vector<float> lengths{float(linkerLength)};
+	lengths.insert(lengths.end(), linkerLengthSweep.begin(),
+		       linkerLengthSweep.end());
+	auto avs = calculateAV3Sweep(xyzW, xyzW[atom_i], lengths, linkerWidth,
+				     {radius[0], radius[1], radius[2]},
+				     gridResolution, contactR, trappedFrac,
+				     avOptions, history);
+	return sweepResult(std::move(avs), lengths, gridResolution,
+			   minVolumeSphereFraction);
+}
+
+float PositionSimulationAV3::influenceRadius(float maxAtomR) const
 {
-	std::vector<Eigen::Vector4f> res =
-		calculateAV3(xyzW, xyzW[atom_i], linkerLength, linkerWidth,
-			     {radius[0], radius[1], radius[2]}, gridResolution,
-			     contactR, trappedFrac);
-	double volfrac = res.size()
-			 / (4.0 / 3.0 * 3.14159
-			    * std::pow(linkerLength / gridResolution, 3.0));
-	if (minVolumeSphereFraction > volfrac) {
-		res.clear();
+	// the AV cube extends by 2*maxAtomR beyond the linker length, clashes
+	// and contacts reach a bit further.
+	const float probeR = std::max({linkerWidth * 0.5, double(radius[0]),
+				       double(radius[1]), double(radius[2])});
+	double maxLength = linkerLength;
+	for (double length : linkerLengthSweep) {
+		maxLength = std::max(maxLength, length);
 	}
-	return PositionSimulationResult(std::move(res));
+	return maxLength + 2.0f * maxAtomR + probeR + contactR
+	       + 2.0f * gridResolution;
 }
 
 PositionSimulation::Setting PositionSimulationAV1::setting(int row) const
@@ -149,12 +314,35 @@ PositionSimulation::Setting PositionSimulationAV1::setting(int row) const
 		return Setting{"contact_volume_trapped_fraction", trappedFrac};
 	case 7:
 		return Setting{"chain_weighting", chainWeighting};
+	case 8:
+		return Setting{"path_length_engine",
+			       QString::fromStdString(pathLengthEngineName(
+				       avOptions.pathEngine))};
+	case 9:
+		return Setting{"occupancy_backend",
+			       QString::fromStdString(occupancyBackendName(
+				       avOptions.occupancyBackend))};
+	case 10:
+		return Setting{"linker_length_sweep",
+			       lengthsString(linkerLengthSweep)};
+	case 11:
+		return Setting{"incremental", incrementalUpdate};
+	case 12:
+		return Setting{"incremental_tolerance", incrementalTolerance};
+	case 13:
+		return Setting{"coarse_grid_factor", avOptions.coarseFactor};
+	case 14:
+		return Setting{"path_stencil",
+			       QString::fromStdString(
+				       pathStencilName(avOptions.stencil))};
 	}
 	return Setting();
 }
 
 void PositionSimulationAV1::setSetting(int row, const QVariant &val)
 {
+	// results of the other settings can not be reused
+	avHistories.clear();
 	switch (row) {
 	case 0:
 		gridResolution = val.toDouble();
@@ -182,25 +370,65 @@ void PositionSimulationAV1::setSetting(int row, const QVariant &val)
 		chainWeighting = val.toBool();
 		setWeightingFunction();
 		return;
+	case 8:
+		avOptions.pathEngine =
+			pathLengthEngine(val.toString().toStdString());
+		return;
+	case 9:
+		avOptions.occupancyBackend =
+			occupancyBackend(val.toString().toStdString());
+		return;
+	case 10:
+		linkerLengthSweep = parseLengths(val.toString());
+		return;
+	case 11:
+		incrementalUpdate = val.toBool();
+		return;
+	case 12:
+		incrementalTolerance = val.toDouble();
+		return;
+	case 13:
+		avOptions.coarseFactor = std::max(1, val.toInt());
+		return;
+	case 14:
+		avOptions.stencil = pathStencil(val.toString().toStdString());
+		return;
 	}
 }
 
 PositionSimulationResult
 PositionSimulationAV1::calculate(unsigned atom_i,
-				 const std::vector<Eigen::Vector4f> &xyzW)
+				 const std::vector<Eigen::Vector4f> &xyzW,
+				 AVHistory *history)
 {
-	std::vector<Eigen::Vector4f> res;
-	res = calculateAV(xyzW, xyzW[atom_i], linkerLength, linkerWidth, radius,
-			  gridResolution, contactR, trappedFrac,
-			  weightingFunction);
-	double volfrac = res.size()
-			 / (4.0 / 3.0 * 3.14159
-			    * std::pow(linkerLength / gridResolution, 3.0));
-	if (minVolumeSphereFraction > volfrac) {
-		res.clear();
+	if (history) {
+		history->tolerance = incrementalTolerance;
 	}
-	return PositionSimulationResult(std::move(res));
+	std::vector<float> lengths{float(linkerLength)};
+	std::vector<TabulatedFunction> weightings{weightingFunction};
+	for (double length : linkerLengthSweep) {
+		lengths.push_back(length);
+		weightings.push_back(weightingFunctionFor(length));
+	}
+	auto avs = calculateAVSweep(xyzW, xyzW[atom_i], lengths, linkerWidth,
+				    radius, gridResolution, contactR,
+				    trappedFrac, weightings, avOptions,
+				    history);
+	return sweepResult(std::move(avs), lengths, gridResolution,
+			   minVolumeSphereFraction);
 }
+
+float PositionSimulationAV1::influenceRadius(float maxAtomR) const
+{
+	const float probeR = std::max(linkerWidth * 0.5, radius);
+	double maxLength = linkerLength;
+	for (double length : linkerLengthSweep) {
+		maxLength = std::max(maxLength, length);
+	}
+	return maxLength + 2.0f * maxAtomR + probeR + contactR
+	       + 2.0f * gridResolution;
+}
+
 std::map<double, TabulatedFunction> PositionSimulationAV1::weightingFunctions{};
 std::map<double, TabulatedFunction>
 PositionSimulationAV1::loadWeightingFunctions()
@@ -269,20 +497,23 @@ PositionSimulationAV1::loadWeightingFunctions()
 }
 
 void PositionSimulationAV1::setWeightingFunction() const
+{
+	weightingFunction = weightingFunctionFor(linkerLength);
+}
+
+TabulatedFunction
+PositionSimulationAV1::weightingFunctionFor(double length) const
 {
 	if (!chainWeighting) {
-		weightingFunction = weightingFunctions.at(0.0);
-		return;
+		return weightingFunctions.at(0.0);
 	}
-	auto it = weightingFunctions.lower_bound(linkerLength);
+	auto it = weightingFunctions.lower_bound(length);
 	if (it == weightingFunctions.end()) {
-		weightingFunction = weightingFunctions.at(0);
 		std::cerr
 			<< "could not find a weighting fucntion for linker length of "
-				   + std::to_string(linkerLength)
-				   + " Angstrom.\n"
+				   + std::to_string(length) + " Angstrom.\n"
 			<< std::flush;
-		return;
+		return weightingFunctions.at(0);
 	}
-	weightingFunction = it->second;
+	return it->second;
 }
@@ -3,6 +3,11 @@
 #include <Eigen/Dense>
 
 #include <array>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "PositionSimulationResult.h"
@@ -10,6 +15,37 @@
 #include "AbstractEvaluator.h"
 
 
+// AVHistory of every trajectory, for which a labeling position was
+// calculated. A copy starts empty, so that cloned simulations do not share
+// the state.
+class AVHistoryCache
+{
+public:
+	AVHistoryCache() = default;
+	AVHistoryCache(const AVHistoryCache & /*other*/)
+	{
+	}
+	AVHistoryCache &operator=(const AVHistoryCache & /*other*/)
+	{
+		clear();
+		return *this;
+	}
+	// Locks the history of the trajectory. If it is in use by another
+	// thread (e.g. a neighbouring frame), history is set to nullptr and
+	// the calculation has to be done from scratch.
+	std::unique_lock<std::mutex> lock(const std::string &trajectory,
+					  AVHistory *&history);
+	void clear();
+
+private:
+	struct Slot {
+		std::mutex mutex;
+		AVHistory history;
+	};
+	std::mutex _mutex;
+	std::map<std::string, std::unique_ptr<Slot>> _slots;
+};
+
 class XYZVstore;
 class PositionSimulation
 {
@@ -20,13 +56,28 @@ public:
 	{
 		return -1;
 	}
+	// trajectory identifies the sequence of frames, the consecutive
+	// frames of which can reuse each others results (see incremental())
 	virtual PositionSimulationResult
 	calculate(const Eigen::Vector3f &attachmentAtomPos,
-		  const std::vector<Eigen::Vector4f> &xyzW);
+		  const std::vector<Eigen::Vector4f> &xyzW,
+		  const std::string &trajectory = "");
 	virtual PositionSimulationResult
 	calculate(unsigned atom_i,
-		  const std::vector<Eigen::Vector4f>
-			  &xyzW) = 0; // v.d.Waals radii
+		  const std::vector<Eigen::Vector4f> &xyzW, // v.d.Waals radii
+		  AVHistory *history) = 0;
+	// whether the previous frame of the same trajectory should be passed
+	// to calculate() as history
+	virtual bool incremental() const
+	{
+		return false;
+	}
+	// Atoms further away from the attachment atom than this can not affect
+	// the result. maxAtomR is the largest v.d.Waals radius in the system.
+	virtual float influenceRadius(float /*maxAtomR*/) const
+	{
+		return std::numeric_limits<float>::infinity();
+	}
 	static PositionSimulation *
 	create(const Position::SimulationType &simulationType);
 	virtual PositionSimulation *Clone() = 0;
@@ -38,6 +89,17 @@ public:
 
 protected:
 	const float vdWRMax = 6.0f;
+	AVHistoryCache avHistories;
+
+	// linker_length_sweep is stored as a space or comma separated list
+	static std::vector<double> parseLengths(const QString &str);
+	static QString lengthsString(const std::vector<double> &lengths);
+	// AV for the main linker length with the sweep AVs attached,
+	// avs[0] corresponds to the main length
+	static PositionSimulationResult
+	sweepResult(std::vector<std::vector<Eigen::Vector4f>> &&avs,
+		    const std::vector<float> &linkerLengths,
+		    double gridResolution, double minVolumeSphereFraction);
 };
 
 class PositionSimulationAV3 : public PositionSimulation
@@ -54,15 +116,21 @@ public:
 	virtual void setSetting(int row, const QVariant &val);
 	virtual int settingsCount() const
 	{
-		return 9;
+		return 16;
 	}
 	virtual PositionSimulation *Clone()
 	{
 		return new PositionSimulationAV3(*this);
 	}
+	virtual float influenceRadius(float maxAtomR) const;
+	virtual bool incremental() const
+	{
+		return incrementalUpdate;
+	}
 	using PositionSimulation::calculate;
 	virtual PositionSimulationResult
-	calculate(unsigned atom_i, const std::vector<Eigen::Vector4f> &xyzW);
+	calculate(unsigned atom_i, const std::vector<Eigen::Vector4f> &xyzW,
+		  AVHistory *history);
 
 private:
 	double gridResolution = 0.9;
@@ -72,6 +140,10 @@ private:
 	double minVolumeSphereFraction = 0.0;
 	double contactR = 0.0;
 	double trappedFrac = -1.0;
+	AVOptions avOptions;
+	std::vector<double> linkerLengthSweep;
+	bool incrementalUpdate = false;
+	double incrementalTolerance = 0.05;
 
 	const int linknodes = 3;
 };
@@ -96,15 +168,21 @@ public:
 	virtual void setSetting(int row, const QVariant &val);
 	virtual int settingsCount() const
 	{
-		return 8;
+		return 15;
 	}
 	virtual PositionSimulation *Clone()
 	{
 		return new PositionSimulationAV1(*this);
 	}
+	virtual float influenceRadius(float maxAtomR) const;
+	virtual bool incremental() const
+	{
+		return incrementalUpdate;
+	}
 	using PositionSimulation::calculate;
 	virtual PositionSimulationResult
-	calculate(unsigned atom_i, const std::vector<Eigen::Vector4f> &xyzW);
+	calculate(unsigned atom_i, const std::vector<Eigen::Vector4f> &xyzW,
+		  AVHistory *history);
 
 private:
 	double gridResolution = 0.9;
@@ -115,6 +193,10 @@ private:
 	double contactR = 0.0;
 	double trappedFrac = -1.0;
 	bool chainWeighting = false;
+	AVOptions avOptions;
+	std::vector<double> linkerLengthSweep;
+	bool incrementalUpdate = false;
+	double incrementalTolerance = 0.05;
 
 	const int linknodes = 3;
 
@@ -122,6 +204,7 @@ private:
 	static std::map<double, TabulatedFunction> loadWeightingFunctions();
 	static std::map<double, TabulatedFunction> weightingFunctions;
 	void setWeightingFunction() const;
+	TabulatedFunction weightingFunctionFor(double length) const;
 };
 
 class PositionSimulationAtom : public PositionSimulation
@@ -145,9 +228,14 @@ public:
 	{
 		return new PositionSimulationAtom(*this);
 	}
+	virtual float influenceRadius(float /*maxAtomR*/) const
+	{
+		return 1.0f;
+	}
 	using PositionSimulation::calculate;
 	virtual PositionSimulationResult
-	calculate(unsigned atom_i, const std::vector<Eigen::Vector4f> &xyzW)
+	calculate(unsigned atom_i, const std::vector<Eigen::Vector4f> &xyzW,
+		  AVHistory * /*history*/)
 	{
 		std::vector<Eigen::Vector4f> vec(1);
 		vec[0] = xyzW[atom_i];
@@ -1,63 +1,234 @@
 #include "PositionSimulationResult.h"
-#include <random>
+#include "AtomCellList.h"
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
 #include <fstream>
 #include <cmath>
+#include <tuple>
 
-Eigen::Vector3f PositionSimulationResult::meanPosition() const
+PositionSimulationResult::PositionSimulationResult(
+	std::vector<Eigen::Vector4f> &&points)
+    : _points(std::make_shared<const std::vector<Eigen::Vector4f>>(
+	      std::move(points))),
+      _soa(std::make_shared<const AVPoints>(*_points))
 {
+	Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+	double totalW = 0.0;
+	for (const Eigen::Vector4f &point : *_points) {
+		sum += point.head<3>() * point[3];
+		totalW += point[3];
+	}
+	sum /= totalW;
+	_meanPosition = sum;
+}
+
+void PositionSimulationResult::translate(const Eigen::Vector3f r)
+{
+	auto points = std::make_shared<std::vector<Eigen::Vector4f>>(*_points);
+	for (auto &point : *points) {
+		point.head(3) += r;
+	}
+	_points = std::move(points);
+	_soa = std::make_shared<const AVPoints>(*_points);
+	_octree = std::make_shared<Cached<AVOctree>>();
+	_surface = std::make_shared<Cached<Surface>>();
+	_meanPosition += r;
+}
 
-	if (std::isnan(_meanPosition(0))) {
-		Eigen::Vector3f tmp;
-		tmp.fill(0.0);
+const PositionSimulationResult::Moments &
+PositionSimulationResult::moments() const
+{
+	std::call_once(_moments->once, [this] {
+		using Eigen::Vector3d;
+		Vector3d mean = Vector3d::Zero();
 		double totalW = 0.0;
-		for (const Eigen::Vector4f &point : _points) {
-			tmp += point.head<3>() * point[3];
+		for (const Eigen::Vector4f &point : *_points) {
+			mean += point.head<3>().cast<double>() * point[3];
 			totalW += point[3];
 		}
-		tmp /= totalW;
-		_meanPosition = tmp;
+		mean /= totalW;
+		Moments &m = _moments->value;
+		m.covariance.setZero();
+		for (Eigen::Matrix3d &third : m.third) {
+			third.setZero();
+		}
+		m.fourth = m.extent = 0.0;
+		for (const Eigen::Vector4f &point : *_points) {
+			const Vector3d e =
+				point.head<3>().cast<double>() - mean;
+			const double w = point[3], eSq = e.squaredNorm();
+			const Eigen::Matrix3d outer = w * e * e.transpose();
+			m.covariance += outer;
+			for (int i = 0; i < 3; ++i) {
+				m.third[i] += e[i] * outer;
+			}
+			m.fourth += w * eSq * eSq;
+			m.extent = std::max(m.extent, eSq);
+		}
+		m.covariance /= totalW;
+		for (Eigen::Matrix3d &third : m.third) {
+			third /= totalW;
+		}
+		m.fourth /= totalW;
+		m.extent = std::sqrt(m.extent);
+	});
+	return _moments->value;
+}
+
+namespace
+{
+// number of the surface points per chunk for minDistance()
+constexpr size_t surfaceChunk = 256;
+
+// the far-field expansion is tried, if the distance between the mean
+// positions is above farFieldRatio*(extent1+extent2)
+constexpr double farFieldRatio = 1.5;
+
+// The far-field value replaces the Monte-Carlo one, if its error estimate
+// is below tolerance, with tolerance=0 below the standard error of
+// nsamples random pairs.
+bool farFieldAccepted(double error, double deviation, double tolerance,
+		      double nsamples)
+{
+	return error <= (tolerance > 0.0 ? tolerance
+					  : deviation / std::sqrt(nsamples));
+}
+
+std::array<double, 5> distanceTaylor(double r)
+{
+	return {r, 1.0, 0.0, 0.0, 0.0};
+}
+
+// Taylor coefficients E^(k)(r)/k!, k<=4, of E(r)=1/(1+(r/R0)^6)
+std::array<double, 5> efficiencyTaylor(double r, double R0)
+{
+	// series of 1+(x+h)^6 in h, x=r/R0, then of its reciprocal
+	static constexpr double binomial[5] = {1.0, 6.0, 15.0, 20.0, 15.0};
+	const double x = r / R0;
+	std::array<double, 5> p, c;
+	for (int k = 0; k < 5; ++k) {
+		p[k] = binomial[k] * std::pow(x, 6 - k);
+	}
+	p[0] += 1.0;
+	for (int k = 0; k < 5; ++k) {
+		double sum = k == 0 ? 1.0 : 0.0;
+		for (int j = 1; j <= k; ++j) {
+			sum -= p[j] * c[k - j];
+		}
+		c[k] = sum / p[0];
+	}
+	double scale = 1.0;
+	for (double &coef : c) {
+		coef *= scale;
+		scale /= R0;
+	}
+	return c;
+}
+} // namespace
+
+template <typename Coefs>
+PositionSimulationResult::FarField
+PositionSimulationResult::farField(const PositionSimulationResult &other,
+				   Coefs &&coefs) const
+{
+	// The pairs are p2-p1=r+e, e=e2-e1, d=|r|. With t=u.e, u=r/d, and
+	// s^2=|e|^2-t^2 the expansion of g(|r+e|) is
+	// g+g'*t+g'*s^2/(2d)+g''*t^2/2+g'''*t^3/6+(g''/(2d)-g'/(2d^2))*t*s^2
+	// up to the third order. The means of t, t^2, t^3 and t*|e|^2 follow
+	// from the moments of both AVs.
+	const Moments &m1 = moments(), &m2 = other.moments();
+	const Eigen::Vector3d r =
+		(other.meanPosition() - meanPosition()).cast<double>();
+	const double d = r.norm();
+	if (!(d > farFieldRatio * (m1.extent + m2.extent))) {
+		return {nan, nan, nan};
 	}
-	return _meanPosition;
+	const Eigen::Vector3d u = r / d;
+	const Eigen::Matrix3d cov = m1.covariance + m2.covariance;
+	const double tt = u.dot(cov * u), ss = cov.trace() - tt;
+	double ttt = 0.0, tee = 0.0;
+	for (int i = 0; i < 3; ++i) {
+		const Eigen::Matrix3d third = m2.third[i] - m1.third[i];
+		ttt += u[i] * u.dot(third * u);
+		tee += u[i] * third.trace();
+	}
+	const double tss = tee - ttt;
+	const double eeee =
+		m1.fourth + m2.fourth
+		+ 2.0 * m1.covariance.trace() * m2.covariance.trace()
+		+ 4.0 * (m1.covariance * m2.covariance).trace();
+
+	const std::array<double, 5> c = coefs(d);
+	FarField res;
+	res.value = c[0] + c[1] * ss / (2.0 * d) + c[2] * tt + c[3] * ttt
+		    + (c[2] / d - c[1] / (2.0 * d * d)) * tss;
+	// the fourth order term is c4*t^4+b*t^2*s^2+a*s^4, t^2*s^2<=|e|^4/4
+	const double d3 = d * d * d;
+	const double b = c[1] / (2.0 * d3) - c[2] / (d * d) + 1.5 * c[3] / d;
+	const double a = c[2] / (4.0 * d * d) - c[1] / (8.0 * d3);
+	res.error =
+		eeee * (std::abs(c[4]) + 0.25 * std::abs(b) + std::abs(a));
+	res.deviation = std::abs(c[1]) * std::sqrt(tt);
+	return res;
 }
 
 std::vector<double>
 PositionSimulationResult::RdaDist(const PositionSimulationResult &other,
 				  double distMin, double distMax,
-				  double numBins, unsigned nsamples) const
+				  double numBins, unsigned nsamples,
+				  std::uint64_t seed) const
 {
 	double binSize = (distMax - distMin) / numBins;
-	unsigned long av1length = _points.size();
-	unsigned long av2length = other._points.size();
-	std::random_device rd;
-	std::mt19937 engine(rd());
-	std::uniform_int_distribution<unsigned long> dist1(0, av1length - 1);
-	std::uniform_int_distribution<unsigned long> dist2(0, av2length - 1);
-
 	std::vector<double> hist(numBins, 0.0);
-	for (unsigned i = 0; i < nsamples; i++) {
-		unsigned long i1, i2;
-		i1 = dist1(engine);
-		i2 = dist2(engine);
-		double w = _points.at(i1)[3] * other._points.at(i2)[3];
-		double r = (_points.at(i1) - other._points.at(i2))
-				   .head<3>()
-				   .norm();
-		int ibin = (r - distMin) / binSize;
-		if (ibin < numBins)
-			hist[ibin] += w;
+	if (empty() || other.empty()) {
+		return hist;
+	}
+	if (_gridStep > 0.0f && _gridStep == other._gridStep) {
+		// the correlation of a grid with n points takes about as long
+		// as drawing n*log2(n) random pairs
+		const LatticeDensity a(*_points, _gridStep);
+		const LatticeDensity b(*other._points, _gridStep);
+		const double n = a.valid() && b.valid()
+					 ? latticeCorrelationSize(a, b)
+					 : 0.0;
+		if (n > 0.0 && n * std::log2(n) < nsamples) {
+			hist = latticeDistanceHistogram(a, b, distMin, binSize,
+							numBins);
+			const double scale =
+				double(nsamples) / size() / other.size();
+			for (double &h : hist) {
+				h *= scale;
+			}
+			return hist;
+		}
 	}
+	// the pairs are drawn proportionally to their weights, each one counts
+	// with the mean weight of a pair
+	const double w = _soa->totalWeight() / size()
+			 * other._soa->totalWeight() / other.size();
+	auto fill = [&](const float *rSq, size_t n) {
+		for (size_t k = 0; k < n; ++k) {
+			double r = std::sqrt(rSq[k]);
+			double bin = (r - distMin) / binSize;
+			if (bin >= 0.0 && bin < numBins) {
+				hist[int(bin)] += w;
+			}
+		}
+		return true;
+	};
+	_soa->forSampledPairs(*other._soa, nsamples, seed, fill);
 	return hist;
 }
 
 double PositionSimulationResult::meanFretEfficiency(
-	const PositionSimulationResult &other, const double R0) const
+	const PositionSimulationResult &other, const double R0,
+	std::uint64_t seed, double tolerance) const
 {
 	const unsigned long nsamples = 40000;
 
-	unsigned long av1length = _points.size();
-	unsigned long av2length = other._points.size();
+	unsigned long av1length = _points->size();
+	unsigned long av2length = other._points->size();
 	if (av1length == 0 || av2length == 0) {
 		return std::numeric_limits<double>::quiet_NaN();
 	}
@@ -66,162 +237,82 @@ double PositionSimulationResult::meanFretEfficiency(
 	if (rndLim < nsamples) {
 		return meanFretEfficiencyExhaustive(other, R0);
 	}
-
-	std::random_device rd;
-	std::mt19937 engine(rd());
-	double eff = 0.0;
-	unsigned long i1, i2;
-	std::uniform_int_distribution<unsigned long> dist(0, rndLim);
-	double totalW = 0.0;
-	for (unsigned i = 0; i < nsamples / 2; i++) {
-		i1 = dist(engine);
-		i2 = dist(engine);
-
-		double w = _points.at(i1 % av1length)[3]
-			   * other._points.at(i2 % av2length)[3];
-		totalW += w;
-		double r = (_points.at(i1 % av1length)
-			    - other._points.at(i2 % av2length))
-				   .head<3>()
-				   .norm();
-		eff += 1.0 / (1.0 + std::pow(r / R0, 6.0)) * w;
-
-		w = _points.at(i2 % av1length)[3]
-		    * other._points.at(i1 % av2length)[3];
-		totalW += w;
-		r = (_points.at(i2 % av1length)
-		     - other._points.at(i1 % av2length))
-			    .head<3>()
-			    .norm();
-		eff += 1.0 / (1.0 + std::pow(r / R0, 6.0)) * w;
-	}
-	return eff / totalW;
+	const FarField far = farField(
+		other, [R0](double r) { return efficiencyTaylor(r, R0); });
+	if (farFieldAccepted(far.error, far.deviation, tolerance, nsamples)) {
+		return far.value;
+	}
+	return _soa->sampledEfficiency(*other._soa, R0, nsamples, seed,
+				       tolerance);
 }
 double PositionSimulationResult::meanFretEfficiencyExhaustive(
 	const PositionSimulationResult &other, const double R0) const
 {
-	double totalW = 0.0;
-	double eff = 0.0;
-	for (int i = 0; i < _points.size(); ++i) {
-		for (int j = 0; j < other._points.size(); ++j) {
-			double w = _points.at(i)[3] * other._points.at(j)[3];
-			totalW += w;
-			double r = (_points.at(i) - other._points.at(j))
-					   .head<3>()
-					   .norm();
-			eff += 1.0 / (1.0 + std::pow(r / R0, 6.0)) * w;
-		}
-	}
-	return eff / totalW;
+	const double totalW = _soa->totalWeight() * other._soa->totalWeight();
+	return _soa->efficiencySum(*other._soa, R0) / totalW;
 }
 double PositionSimulationResult::Rda(const PositionSimulationResult &other,
-				     unsigned nsamples) const
+				     unsigned nsamples, std::uint64_t seed,
+				     double tolerance) const
 {
-	using std::min;
-	unsigned long av1length = _points.size();
-	unsigned long av2length = other._points.size();
-	const unsigned long rndLim = (av1length - 1) * (av2length - 1);
+	unsigned long av1length = _points->size();
+	unsigned long av2length = other._points->size();
 
 	if (nsamples < (av1length * av2length) && nsamples != 0) // MC sampling
 	{
-		std::random_device rd;
-		std::mt19937 engine(rd());
-		double r = 0.;
-		unsigned long i1, i2;
-		std::uniform_int_distribution<unsigned long> dist(0, rndLim);
-		double totalW = 0.0;
-		for (unsigned i = 0; i < nsamples / 2; i++) {
-			i1 = dist(engine);
-			i2 = dist(engine);
-			float w = _points.at(i1 % av1length)[3]
-				  * other._points.at(i2 % av2length)[3];
-			totalW += w;
-			r += (_points.at(i1 % av1length)
-			      - other._points.at(i2 % av2length))
-				     .head<3>()
-				     .norm()
-			     * w;
-			w = _points.at(i2 % av1length)[3]
-			    * other._points.at(i1 % av2length)[3];
-			totalW += w;
-			r += (_points.at(i2 % av1length)
-			      - other._points.at(i1 % av2length))
-				     .head<3>()
-				     .norm()
-			     * w;
+		const FarField far = farField(other, distanceTaylor);
+		if (farFieldAccepted(far.error, far.deviation, tolerance,
+				     nsamples)) {
+			return far.value;
 		}
-		return r / totalW;
+		return _soa->sampledDistance(*other._soa, nsamples, seed,
+					     tolerance);
 	} else // explicit sampling
 	{
-		double r = 0.0;
-		double totalW = 0.0;
-		for (unsigned i = 0; i < av1length; i++) {
-			for (unsigned j = 0; j < av2length; j++) {
-				float w = _points.at(i)[3]
-					  * other._points.at(j)[3];
-				totalW += w;
-				r += (_points.at(i) - other._points.at(j))
-					     .head<3>()
-					     .norm()
-				     * w;
-			}
-		}
-		return r / totalW;
+		const double totalW =
+			_soa->totalWeight() * other._soa->totalWeight();
+		return _soa->distanceSum(*other._soa) / totalW;
 	}
 }
 
 double PositionSimulationResult::Rdae(const PositionSimulationResult &other,
-				      double R0, unsigned nsamples) const
+				      double R0, unsigned nsamples,
+				      std::uint64_t seed,
+				      double tolerance) const
 {
-	using std::min;
-	unsigned long av1length = _points.size();
-	unsigned long av2length = other._points.size();
-	const unsigned long rndLim = (av1length - 1) * (av2length - 1);
-	double r2, e = 0., R0r6 = 1. / (R0 * R0 * R0 * R0 * R0 * R0);
+	unsigned long av1length = _points->size();
+	unsigned long av2length = other._points->size();
+	double e = 0.;
 	if (nsamples < av1length * av2length && nsamples != 0) // MC sampling
 	{
-		std::random_device rd;
-		std::mt19937 engine(rd());
-		std::uniform_int_distribution<unsigned long> distr(0, rndLim);
-		int i1, i2;
-		double totalW = 0.0;
-		for (unsigned i = 0; i < nsamples / 2; i++) {
-			i1 = distr(engine);
-			i2 = distr(engine);
-			float w = _points.at(i1 % av1length)[3]
-				  * other._points.at(i2 % av2length)[3];
-			totalW += w;
-			r2 = (_points.at(i1 % av1length)
-			      - other._points.at(i2 % av2length))
-				     .head<3>()
-				     .squaredNorm();
-			e += w / (1. + r2 * r2 * r2 * R0r6);
-
-			w = _points.at(i2 % av1length)[3]
-			    * other._points.at(i1 % av2length)[3];
-			totalW += w;
-			r2 = (_points.at(i2 % av1length)
-			      - other._points.at(i1 % av2length))
-				     .head<3>()
-				     .squaredNorm();
-			e += w / (1. + r2 * r2 * r2 * R0r6);
+		// standard error of Rdae from the one of E:
+		// dRdae/dE = -Rdae/(6*E*(1-E))
+		const FarField far = farField(other, [R0](double r) {
+			return efficiencyTaylor(r, R0);
+		});
+		const double rdae = R0 * pow((1. / far.value - 1.), 1. / 6.);
+		const double dRdE =
+			rdae / (6. * far.value * (1. - far.value));
+		if (farFieldAccepted(far.error * dRdE, far.deviation * dRdE,
+				     tolerance, nsamples)) {
+			return rdae;
 		}
-		e /= totalW;
+		const float invR0Sq = float(1.0 / (R0 * R0));
+		auto efficiency = [invR0Sq](float rSq) {
+			return AVPoints::efficiency(rSq, invR0Sq);
+		};
+		auto done = [R0, tolerance](double mean, double error) {
+			const double rdae = R0 * pow((1. / mean - 1.), 1. / 6.);
+			const double dRdE = rdae / (6. * mean * (1. - mean));
+			return error * dRdE < tolerance;
+		};
+		e = _soa->sampledMean(*other._soa, nsamples, seed, efficiency,
+				      done);
 	} else // explicit sampling
 	{
-		double totalW = 0.0;
-		for (unsigned i = 0; i < av1length; i++) {
-			for (unsigned j = 0; j < av2length; j++) {
-				float w = _points.at(i)[3]
-					  * other._points.at(j)[3];
-				totalW += w;
-				r2 = (_points.at(i) - other._points.at(j))
-					     .head<3>()
-					     .squaredNorm();
-				e += w / (1. + r2 * r2 * r2 * R0r6);
-			}
-		}
-		e /= totalW;
+		const double totalW =
+			_soa->totalWeight() * other._soa->totalWeight();
+		e = _soa->efficiencySum(*other._soa, R0) / totalW;
 	}
 	return R0 * pow((1. / e - 1.), 1. / 6.);
 }
@@ -242,24 +333,292 @@ PositionSimulationResult::Rmp(const PositionSimulationResult &other) const
 double
 PositionSimulationResult::modelDistance(const PositionSimulationResult &other,
 					const std::string &type,
-					double R0) const
+					double R0, std::uint64_t seed,
+					double tolerance) const
 {
 	if (type == "RDAMean") {
-		return Rda(other);
+		return Rda(other, 200000, seed, tolerance);
 	} else if (type == "Rmp") {
 		return Rmp(other);
 	} else if (type == "RDAMeanE") {
-		return Rdae(other, R0);
+		return Rdae(other, R0, 200000, seed, tolerance);
 	}
 	// should never reach here;
 	std::cerr << "Distance type is unknown: " << type << std::endl;
 	return -100.0;
 }
 
+AVPairStatistics
+PositionSimulationResult::pairStatistics(const PositionSimulationResult &other,
+					 const std::vector<double> &R0s,
+					 std::uint64_t seed,
+					 unsigned nsamples) const
+{
+	AVPairStatistics stats;
+	stats.Rmp = Rmp(other);
+	stats.R0 = R0s;
+	stats.Rda = nan;
+	stats.efficiency.assign(R0s.size(), nan);
+	if (empty() || other.empty()) {
+		return stats;
+	}
+	if (size() * other.size() <= nsamples) {
+		const double totalW =
+			_soa->totalWeight() * other._soa->totalWeight();
+		const std::vector<double> sums =
+			_soa->pairSums(*other._soa, R0s);
+		stats.Rda = sums[0] / totalW;
+		for (size_t k = 0; k < R0s.size(); ++k) {
+			stats.efficiency[k] = sums[k + 1] / totalW;
+		}
+		return stats;
+	}
+
+	// the values, which the far-field expansion does not give, are
+	// sampled together
+	const FarField far = farField(other, distanceTaylor);
+	const bool sampleRda =
+		!farFieldAccepted(far.error, far.deviation, 0.0, nsamples);
+	if (!sampleRda) {
+		stats.Rda = far.value;
+	}
+	std::vector<size_t> sampled;
+	std::vector<float> invR0Sq;
+	for (size_t k = 0; k < R0s.size(); ++k) {
+		const double R0 = R0s[k];
+		const FarField farE = farField(other, [R0](double r) {
+			return efficiencyTaylor(r, R0);
+		});
+		if (farFieldAccepted(farE.error, farE.deviation, 0.0,
+				     nsamples)) {
+			stats.efficiency[k] = farE.value;
+		} else {
+			sampled.push_back(k);
+			invR0Sq.push_back(float(1.0 / (R0 * R0)));
+		}
+	}
+	if (!sampleRda && sampled.empty()) {
+		return stats;
+	}
+	double sumR = 0.0;
+	std::vector<double> sumE(sampled.size(), 0.0);
+	auto accumulate = [&](const float *rSq, size_t n) {
+		float batch = 0.0f;
+		for (size_t i = 0; i < n; ++i) {
+			batch += std::sqrt(rSq[i]);
+		}
+		sumR += batch;
+		for (size_t m = 0; m < sampled.size(); ++m) {
+			batch = 0.0f;
+			for (size_t i = 0; i < n; ++i) {
+				batch += AVPoints::efficiency(rSq[i],
+							      invR0Sq[m]);
+			}
+			sumE[m] += batch;
+		}
+		return true;
+	};
+	_soa->forSampledPairs(*other._soa, nsamples, seed, accumulate);
+	if (sampleRda) {
+		stats.Rda = sumR / nsamples;
+	}
+	for (size_t m = 0; m < sampled.size(); ++m) {
+		stats.efficiency[sampled[m]] = sumE[m] / nsamples;
+	}
+	return stats;
+}
+
+const PositionSimulationResult::Surface &
+PositionSimulationResult::surface() const
+{
+	std::call_once(_surface->once, [this] {
+		if (!(_gridStep > 0.0f)) {
+			return;
+		}
+		// occupancy, the weights do not matter
+		std::vector<Eigen::Vector4f> points(*_points);
+		for (Eigen::Vector4f &point : points) {
+			point[3] = 1.0f;
+		}
+		Surface &s = _surface->value;
+		s.lattice = LatticeDensity(points, _gridStep);
+		if (!s.lattice.valid()) {
+			return;
+		}
+		points.clear();
+		for (const Eigen::Vector4f &point : *_points) {
+			const long voxel =
+				s.lattice.nearestVoxel(point.head<3>());
+			if (!s.lattice.interior(voxel)) {
+				points.push_back(point);
+			}
+		}
+		// sorted by cubes of 8 grid steps, then cut into chunks
+		const Eigen::Vector3f origin = s.lattice.origin().cast<float>();
+		const float cube = 8.0f * _gridStep;
+		auto key = [&origin, cube](const Eigen::Vector4f &point) {
+			const Eigen::Array3i c =
+				((point.head<3>() - origin) / cube)
+					.array()
+					.floor()
+					.cast<int>();
+			return std::make_tuple(c[0], c[1], c[2]);
+		};
+		std::sort(points.begin(), points.end(),
+			  [&key](const Eigen::Vector4f &a,
+				 const Eigen::Vector4f &b) {
+				  return key(a) < key(b);
+			  });
+		for (size_t i = 0; i < points.size(); i += surfaceChunk) {
+			const auto first = points.begin() + i;
+			const auto last =
+				points.begin()
+				+ std::min(points.size(), i + surfaceChunk);
+			Eigen::AlignedBox3f box;
+			for (auto it = first; it != last; ++it) {
+				box.extend(it->head<3>());
+			}
+			s.bounds.push_back(box);
+			s.chunks.emplace_back(
+				std::vector<Eigen::Vector4f>(first, last));
+		}
+	});
+	return _surface->value;
+}
+
+double PositionSimulationResult::minDistance(
+	const PositionSimulationResult &other) const
+{
+	// For the closest pair with an inner point p (all 26 neighbours are
+	// occupied), the neighbour of p towards the other point q is at most
+	// as far from q, unless q is within half a step from p. So the
+	// closest pair is found among the surface points, if no point of one
+	// AV is nearest to an occupied voxel of the other one.
+	const Surface &s1 = surface(), &s2 = other.surface();
+	if (!s1.lattice.valid() || !s2.lattice.valid()
+	    || s1.lattice.occupiedNear(*other._points)
+	    || s2.lattice.occupiedNear(*_points)) {
+		return std::sqrt(_soa->minDistanceSq(*other._soa));
+	}
+	// pairs of chunks ordered by the distance of their bounding boxes,
+	// the rest is skipped as soon as it can not be closer
+	std::vector<std::tuple<float, int, int>> pairs;
+	for (size_t i = 0; i < s1.chunks.size(); ++i) {
+		for (size_t j = 0; j < s2.chunks.size(); ++j) {
+			const float lowerSq =
+				s1.bounds[i].squaredExteriorDistance(
+					s2.bounds[j]);
+			pairs.emplace_back(lowerSq, i, j);
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+	float minSq = std::numeric_limits<float>::infinity();
+	for (const auto &pair : pairs) {
+		if (std::get<0>(pair) >= minSq) {
+			break;
+		}
+		const AVPoints &c1 = s1.chunks[std::get<1>(pair)];
+		const AVPoints &c2 = s2.chunks[std::get<2>(pair)];
+		minSq = std::min(minSq, c1.minDistanceSq(c2));
+	}
+	return std::sqrt(minSq);
+}
+
+float PositionSimulationResult::overlap(
+	const std::vector<Eigen::Vector3f> &refs, float maxR) const
+{
+	if (_points->size() == 0) {
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	// cells of maxR, every point checks the neighbouring cells only
+	std::vector<Eigen::Vector4f> spheres;
+	spheres.reserve(refs.size());
+	for (const Eigen::Vector3f &ref : refs) {
+		spheres.emplace_back(ref[0], ref[1], ref[2], maxR);
+	}
+	const AtomCellList cells = maxR > 0.0f ? AtomCellList(spheres, maxR)
+					       : AtomCellList();
+	float totalVol = 0.0f;
+	float overlapVol = 0.0f;
+	for (const Eigen::Vector4f &point : *_points) {
+		totalVol += point[3];
+		if (cells.anyWithin(point.head<3>(), maxR)) {
+			overlapVol += point[3];
+		}
+	}
+	return overlapVol / totalVol;
+}
+
+const AVOctree &PositionSimulationResult::octree() const
+{
+	std::call_once(_octree->once,
+		       [this] { _octree->value = AVOctree(*_points); });
+	return _octree->value;
+}
+
+BoundedValue PositionSimulationResult::approxFretEfficiency(
+	const PositionSimulationResult &other, double R0,
+	double tolerance) const
+{
+	return octree().meanEfficiency(other.octree(), R0, tolerance);
+}
+
+BoundedValue
+PositionSimulationResult::approxRdae(const PositionSimulationResult &other,
+				     double R0, double tolerance) const
+{
+	// Rdae falls with E, so its bound follows from the range of E. The
+	// tolerance of E is taken from dRdae/dE=-Rdae/(6*E*(1-E)) at the
+	// coarsest estimate and lowered, until the bound of Rdae fits. Near
+	// E=1 the derivative grows without limit, so after a few attempts the
+	// pairs of leaves are summed exactly (tolE=0, zero bound).
+	auto rdae = [R0](double e) {
+		return R0 * std::pow(std::max(1. / e - 1., 0.), 1. / 6.);
+	};
+	const AVOctree &a = octree(), &b = other.octree();
+	BoundedValue e = a.meanEfficiency(
+		b, R0, std::numeric_limits<double>::infinity());
+	double tolE = tolerance * 6. * e.value * (1. - e.value)
+		      / rdae(e.value);
+	if (!std::isfinite(tolE)) {
+		tolE = 0.0;
+	}
+	const int maxAttempts = 8;
+	BoundedValue res;
+	for (int attempt = 0;; ++attempt) {
+		e = a.meanEfficiency(b, R0, tolE);
+		res.value = rdae(e.value);
+		const double lo = rdae(std::min(e.value + e.bound, 1.));
+		const double hi = rdae(std::max(e.value - e.bound, 0.));
+		res.bound = std::max(hi - res.value, res.value - lo);
+		if (res.bound <= tolerance || tolE == 0.0) {
+			return res;
+		}
+		// the bound of Rdae is about proportional to that of E
+		const double shrink = 0.9 * tolerance / res.bound;
+		const double factor = std::min(0.5, shrink);
+		tolE = attempt + 1 < maxAttempts ? tolE * factor : 0.0;
+	}
+}
+
+BoundedValue PositionSimulationResult::approxModelDistance(
+	const PositionSimulationResult &other, const std::string &type,
+	double R0, double tolerance) const
+{
+	if (type == "RDAMean") {
+		return octree().meanDistance(other.octree(), tolerance);
+	} else if (type == "Rmp") {
+		return {Rmp(other), 0.0};
+	} else if (type == "RDAMeanE") {
+		return approxRdae(other, R0, tolerance);
+	}
+	std::cerr << "Distance type is unknown: " << type << std::endl;
+	return {-100.0, 0.0};
+}
 
 std::ostream &PositionSimulationResult::dump_xyz(std::ostream &os) const
 {
-	int n = _points.size();
+	int n = _points->size();
 	std::ios::fmtflags osflags = os.flags();
 	os << n + 1 << "\n";
 	if (n == 0) {
@@ -271,16 +630,15 @@ std::ostream &PositionSimulationResult::dump_xyz(std::ostream &os) const
 	os << std::setprecision(5);
 
 	for (int i = 0; i < n; i++) {
-		if (_points.at(i)[3] != 1.0f) {
+		if (_points->at(i)[3] != 1.0f) {
 			os << "AVc ";
 		} else {
 			os << "AV ";
 		}
-		os << _points.at(i)[0] << "\t";
-		os << _points.at(i)[1] << "\t";
-		os << _points.at(i)[2] << "\n";
+		os << _points->at(i)[0] << "\t";
+		os << _points->at(i)[1] << "\t";
+		os << _points->at(i)[2] << "\n";
 	}
-	meanPosition();
 	os << "AVmp " << _meanPosition[0] << "\t" << _meanPosition[1] << "\t"
 	   << _meanPosition[2] << "\n";
 	os.flags(osflags);
@@ -289,7 +647,7 @@ std::ostream &PositionSimulationResult::dump_xyz(std::ostream &os) const
 
 std::ostream &PositionSimulationResult::dump_pqr(std::ostream &os) const
 {
-	const int n = _points.size();
+	const int n = _points->size();
 	std::ios::fmtflags osflags = os.flags();
 	os.unsetf(std::ios::fixed);
 	using std::fixed;
@@ -298,9 +656,9 @@ std::ostream &PositionSimulationResult::dump_pqr(std::ostream &os) const
 
 	// ATOM      1   AV  AV     0        -0.0    -8.5   -18.9    0.75  0.450
 	for (int i = 0; i < n; i++) {
-		const Eigen::Vector4f &p = _points.at(i);
+		const Eigen::Vector4f &p = _points->at(i);
 		os << "ATOM" << setw(7) << i;
-		if (_points.at(i)[3] != 1.0f) {
+		if (_points->at(i)[3] != 1.0f) {
 			os << "  AVc  AV";
 		} else {
 			os << "   AV  AV";
@@ -312,7 +670,6 @@ std::ostream &PositionSimulationResult::dump_pqr(std::ostream &os) const
 		os << fixed << setw(7) << setprecision(3) << 1.0;
 		os << "\n";
 	}
-	meanPosition();
 	os << "ATOM";
 	os << setw(7) << n + 1 << " AVmp  AV";
 	os << setw(6) << n + 1 << "    ";
@@ -390,7 +747,7 @@ bool PositionSimulationResult::dump_dxmap(const std::string &fileName) const
 
 std::ostream &PositionSimulationResult::dumpShellXyz(std::ostream &os) const
 {
-	if (_points.size() == 0) {
+	if (_points->size() == 0) {
 		os << "AV cloud is empty\n";
 		return os;
 	}
@@ -408,7 +765,6 @@ std::ostream &PositionSimulationResult::dumpShellXyz(std::ostream &os) const
 		os << _shell.at(i)[1] << "\t";
 		os << _shell.at(i)[2] << "\n";
 	}
-	meanPosition();
 	os << "AVmp " << _meanPosition[0] << "\t" << _meanPosition[1] << "\t"
 	   << _meanPosition[2] << "\n";
 	os.flags(osflags);
@@ -461,9 +817,9 @@ PositionSimulationResult::densityArray_t
 PositionSimulationResult::pointsToDensity(double res) const
 {
 	// l,w,d
-	Eigen::Vector3f minLWD(_points.at(0).head<3>());
-	Eigen::Vector3f maxLWD(_points.at(0).head<3>());
-	for (const auto &point : _points) {
+	Eigen::Vector3f minLWD(_points->at(0).head<3>());
+	Eigen::Vector3f maxLWD(_points->at(0).head<3>());
+	for (const auto &point : *_points) {
 		minLWD = minLWD.array().min(point.head<3>().array());
 		maxLWD = maxLWD.array().max(point.head<3>().array());
 	}
@@ -475,7 +831,7 @@ PositionSimulationResult::pointsToDensity(double res) const
 	densityArray_t density(extents);
 	std::fill(density.data(), density.data() + density.num_elements(),
 		  0.0f);
-	for (const auto &point : _points) {
+	for (const auto &point : *_points) {
 		Eigen::Vector3i xyz = (point / res).head(3).cast<int>();
 		density[xyz(0)][xyz(1)][xyz(2)] += point[3];
 	}
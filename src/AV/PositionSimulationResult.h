@@ -3,50 +3,152 @@
 #include <vector>
 #include <iostream>
 #include <array>
+#include <cmath>
 #include <limits>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 #include <Eigen/Dense>
 
 #include <boost/multi_array.hpp>
 
+#include "AVOctree.h"
+#include "AVPoints.h"
+#include "DistanceHistogram.h"
+
+// Statistics of the distances between the points of two AVs, which are
+// computed together in one pass over the pairs of points, see
+// PositionSimulationResult::pairStatistics()
+struct AVPairStatistics {
+	double Rmp, Rda;
+	// Forster radii and <E> for each of them
+	std::vector<double> R0, efficiency;
+
+	// <E> for R0, nan if it was not computed for R0
+	double meanEfficiency(double R0) const
+	{
+		for (size_t k = 0; k < this->R0.size(); ++k) {
+			if (this->R0[k] == R0) {
+				return efficiency[k];
+			}
+		}
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	double Rdae(double R0) const
+	{
+		return R0 * std::pow(1.0 / meanEfficiency(R0) - 1.0, 1.0 / 6.0);
+	}
+};
+
 class PositionSimulationResult
 {
 public:
+	// Copies share the points and everything derived from them, which is
+	// never modified in place, so const references to one result may be
+	// used from several threads at once.
 	PositionSimulationResult()
+	    : _points(std::make_shared<const std::vector<Eigen::Vector4f>>()),
+	      _soa(std::make_shared<const AVPoints>())
+	{
+	}
+	PositionSimulationResult(std::vector<Eigen::Vector4f> &&points);
+
+	// AVs of the same position for other linker lengths
+	// (linker_length_sweep), pairs of {linker length, AV} sorted by length
+	using Sweep = std::vector<std::pair<double, PositionSimulationResult>>;
+	const Sweep &sweep() const
+	{
+		static const Sweep empty;
+		return _sweep ? *_sweep : empty;
+	}
+	void setSweep(Sweep &&sweep)
+	{
+		_sweep = std::make_shared<const Sweep>(std::move(sweep));
+	}
+	// Step of the lattice, on which the points lie (grid resolution of the
+	// simulation), 0 if unknown. Allows exact distance histograms.
+	float gridStep() const
 	{
+		return _gridStep;
 	}
-	PositionSimulationResult(std::vector<Eigen::Vector4f> &&points)
+	void setGridStep(float step)
 	{
-		_points = std::forward<std::vector<Eigen::Vector4f>>(points);
+		_gridStep = step;
+		_surface = std::make_shared<Cached<Surface>>();
 	}
 
-	Eigen::Vector3f meanPosition() const;
+	Eigen::Vector3f meanPosition() const
+	{
+		return _meanPosition;
+	}
+	// Weighted central moments of the points, e=point-mean
+	struct Moments {
+		// E[e*e^T]
+		Eigen::Matrix3d covariance;
+		// E[e_i*e_j*e_k] is third[i](j,k)
+		std::array<Eigen::Matrix3d, 3> third;
+		// E[|e|^4]
+		double fourth;
+		// largest |e|
+		double extent;
+	};
+	// computed on the first use and shared between the copies
+	const Moments &moments() const;
+	// RdaDist() is exact (lattice cross-correlation, see
+	// latticeDistanceHistogram()), if both AVs have the same gridStep()
+	// and this is cheaper than sampling. The exact histogram is scaled to
+	// the expectation of the sampled one.
+	// The Monte-Carlo estimates below draw the random pairs of points from
+	// a counter based generator. The same seed gives the same result, see
+	// AbstractEvaluator::samplingSeed(). With tolerance>0 the sampling
+	// stops as soon as the standard error of the estimate falls below
+	// tolerance (in A for the distances, in the units of E for the
+	// efficiency), nsamples is then the upper limit. The means use the
+	// far-field expansion instead of sampling (see farField()), if the AVs
+	// are far apart compared to their extent and the error estimate of the
+	// expansion is below tolerance (tolerance=0: below the standard error
+	// of the sampling).
 	std::vector<double> RdaDist(const PositionSimulationResult &other,
 				    double distMin, double distMax,
-				    double numBins,
-				    unsigned nsamples = 2000000) const;
+				    double numBins, unsigned nsamples = 2000000,
+				    std::uint64_t seed = 0) const;
 	double meanFretEfficiency(const PositionSimulationResult &other,
-				  const double R0) const;
+				  const double R0, std::uint64_t seed = 0,
+				  double tolerance = 0.0) const;
 	double Rda(const PositionSimulationResult &other,
-		   unsigned nsamples = 200000) const;
+		   unsigned nsamples = 200000, std::uint64_t seed = 0,
+		   double tolerance = 0.0) const;
 	double Rdae(const PositionSimulationResult &other, double R0,
-		    unsigned nsamples = 200000) const;
+		    unsigned nsamples = 200000, std::uint64_t seed = 0,
+		    double tolerance = 0.0) const;
 	double Rmp(const PositionSimulationResult &other) const;
 	double modelDistance(const PositionSimulationResult &other,
-			     const std::string &type, double R0 = 0) const;
-	double minDistance(const PositionSimulationResult &other) const
-	{
-		float minDistSq = std::numeric_limits<double>::infinity();
-		for (const Eigen::Vector4f &p1 : _points) {
-			for (const Eigen::Vector4f &p2 : other._points) {
-				minDistSq = std::min(
-					minDistSq,
-					(p2 - p1).head<3>().squaredNorm());
-			}
-		}
-		return std::sqrt(minDistSq);
-	}
+			     const std::string &type, double R0 = 0,
+			     std::uint64_t seed = 0,
+			     double tolerance = 0.0) const;
+	// Rmp(), Rda() and meanFretEfficiency() for all of R0s from the same
+	// pairs of points: one pass over all pairs for small AVs, otherwise
+	// the far-field expansion or one set of nsamples random pairs (with a
+	// fixed count, as with tolerance=0).
+	AVPairStatistics pairStatistics(const PositionSimulationResult &other,
+					const std::vector<double> &R0s,
+					std::uint64_t seed = 0,
+					unsigned nsamples = 200000) const;
+	// Same values from the compressed AVs (see AVOctree), with a
+	// guaranteed bound of the error, which does not exceed tolerance (in A
+	// for the distances, in the units of E for the efficiency).
+	BoundedValue approxFretEfficiency(const PositionSimulationResult &other,
+					  double R0, double tolerance) const;
+	BoundedValue approxModelDistance(const PositionSimulationResult &other,
+					 const std::string &type, double R0,
+					 double tolerance) const;
+	// built on the first use and shared between the copies
+	const AVOctree &octree() const;
+	// Only the points on the surfaces of the AVs are compared, if both
+	// have a gridStep() and do not interpenetrate.
+	double minDistance(const PositionSimulationResult &other) const;
 	std::ostream &dump_xyz(std::ostream &os) const;
 	std::ostream &dump_pqr(std::ostream &os) const;
 	std::ostream &dumpShellXyz(std::ostream &os) const;
@@ -55,62 +157,55 @@ public:
 	bool dumpShellXyz(const std::string &fileName) const;
 	std::ostream &dump_dxmap(std::ostream &os) const;
 	bool dump_dxmap(const std::string &fileName) const;
+	// points (x, y, z, weight)
+	const std::vector<Eigen::Vector4f> &points() const
+	{
+		return *_points;
+	}
 	bool empty() const
 	{
-		return !_points.size();
+		return _points->empty();
 	}
 	size_t size() const
 	{
-		return _points.size();
+		return _points->size();
 	}
 	size_t freeSize() const
 	{
 		size_t size = 0;
-		for (const auto &point : _points) {
+		for (const auto &point : *_points) {
 			if (point[3] == 1.0f) {
 				++size;
 			}
 		}
 		return size;
 	}
-	void translate(const Eigen::Vector3f r)
-	{
-		for (auto &point : _points) {
-			point.head(3) += r;
-		}
-		_meanPosition += r;
-	}
+	// the translated points are a new copy, other copies keep the old ones
+	void translate(const Eigen::Vector3f r);
+	// weighted fraction of the points, which are closer than maxR to any
+	// of refs
 	float overlap(const std::vector<Eigen::Vector3f> &refs,
-		      float maxR) const
-	{
-		if (_points.size() == 0) {
-			return std::numeric_limits<double>::quiet_NaN();
-		}
-		float totalVol = 0.0f;
-		float overlapVol = 0.0f;
-		const float maxRSq = maxR * maxR;
-		// Eigen::Vector3f mp=meanPosition();
-		for (const Eigen::Vector4f &point : _points) {
-			/*float rMpSq=(mp-point.head<3>()).squaredNorm();
-			float
-			w=(std::exp(-rMpSq/(2.0f*10.0f*10.0f))+1.0f)*0.5f;*/
-			totalVol += point[3];
-			for (const Eigen::Vector3f &ref : refs) {
-				float rSq =
-					(ref - point.head<3>()).squaredNorm();
-				if (rSq < maxRSq) {
-					overlapVol += point[3];
-					break;
-				}
-			}
-		}
-		return overlapVol / totalVol;
-	}
+		      float maxR) const;
 
 private:
 	double
 	meanFretEfficiencyExhaustive(const PositionSimulationResult &other,
 				     const double R0) const;
+	BoundedValue approxRdae(const PositionSimulationResult &other,
+				double R0, double tolerance) const;
+	// Mean of g(|p1-p2|) over the pairs of points from the expansion of g
+	// around the distance of the mean positions up to the third order in
+	// the deviations from the means. coefs are the Taylor coefficients
+	// g^(k)(d)/k!, k<=4, of g at d=Rmp. value is nan, if the AVs are
+	// not far enough apart for the expansion. error estimates the
+	// fourth order term, deviation is the first order estimate of the
+	// standard deviation of g over the pairs.
+	struct FarField {
+		double value, error, deviation;
+	};
+	template <typename Coefs>
+	FarField farField(const PositionSimulationResult &other,
+			  Coefs &&coefs) const;
 
 protected:
 	typedef boost::multi_array<float, 3> densityArray_t;
@@ -123,9 +218,36 @@ protected:
 	static bool allNeighboursFilled(const densityArray_t &arr, int i, int j,
 					int k);
 	std::vector<Eigen::Vector3f> shell(double res = 0.5) const;
-	std::vector<Eigen::Vector4f> _points;
+	std::shared_ptr<const std::vector<Eigen::Vector4f>> _points;
+	// same points in SoA layout for the pairwise kernels, shared between
+	// the copies
+	std::shared_ptr<const AVPoints> _soa;
+	float _gridStep = 0.0f;
+	// computed on the first use and shared between the copies
+	template <typename T> struct Cached {
+		std::once_flag once;
+		T value;
+	};
+	std::shared_ptr<Cached<AVOctree>> _octree =
+		std::make_shared<Cached<AVOctree>>();
+	// translation invariant, kept by translate()
+	std::shared_ptr<Cached<Moments>> _moments =
+		std::make_shared<Cached<Moments>>();
+	// Points with an unoccupied neighbour on the lattice of gridStep(),
+	// in spatially compact chunks with their bounding boxes, and the
+	// occupancy of the lattice. The lattice is invalid without
+	// gridStep().
+	struct Surface {
+		LatticeDensity lattice;
+		std::vector<Eigen::AlignedBox3f> bounds;
+		std::vector<AVPoints> chunks;
+	};
+	const Surface &surface() const;
+	std::shared_ptr<Cached<Surface>> _surface =
+		std::make_shared<Cached<Surface>>();
 	static constexpr double nan = std::numeric_limits<double>::quiet_NaN();
-	mutable Eigen::Vector3f _meanPosition = {nan, nan, nan};
+	Eigen::Vector3f _meanPosition = {nan, nan, nan};
+	std::shared_ptr<const Sweep> _sweep;
 };
 namespace std
 {
@@ -0,0 +1,161 @@
+#include "RmpConverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+// weights summed up to and including each point
+std::vector<double>
+cumulativeWeights(const std::vector<Eigen::Vector4f> &points)
+{
+	std::vector<double> cumulative(points.size());
+	double sum = 0.0;
+	for (size_t i = 0; i < points.size(); ++i) {
+		sum += points[i][3];
+		cumulative[i] = sum;
+	}
+	return cumulative;
+}
+
+// index of a point drawn with the probability proportional to its weight
+size_t samplePoint(const std::vector<double> &cumulative,
+		   std::uint64_t random32)
+{
+	const double x = (random32 + 0.5) / 4294967296.0 * cumulative.back();
+	const auto it =
+		std::upper_bound(cumulative.begin(), cumulative.end(), x);
+	return std::min<size_t>(it - cumulative.begin(), cumulative.size() - 1);
+}
+} // namespace
+
+RmpConverter::RmpConverter(const PositionSimulationResult &av1,
+			   const PositionSimulationResult &av2,
+			   const std::string &type, double R0,
+			   unsigned nsamples, std::uint64_t seed)
+    : _R0(R0)
+{
+	if (type == "Rmp") {
+		_type = Type::Rmp;
+	} else if (type == "RDAMean") {
+		_type = Type::RDAMean;
+	} else if (type == "RDAMeanE") {
+		_type = Type::RDAMeanE;
+	} else {
+		std::cerr << "Distance type is unknown: " << type << std::endl;
+		return;
+	}
+	if (av1.empty() || av2.empty()) {
+		return;
+	}
+	const Eigen::Vector3f mp1 = av1.meanPosition();
+	const Eigen::Vector3f mp2 = av2.meanPosition();
+	Eigen::Vector3f u = mp2 - mp1;
+	// any direction will do for coinciding mean positions
+	u = u.norm() > 1e-6f ? u.normalized() : Eigen::Vector3f::UnitX();
+	auto append = [&](const Eigen::Vector4f &p1, const Eigen::Vector4f &p2,
+			  float w) {
+		const Eigen::Vector3f d =
+			(p2.head<3>() - mp2) - (p1.head<3>() - mp1);
+		const float t = u.dot(d), dSq = d.squaredNorm();
+		_t.push_back(t);
+		_q.push_back(std::max(0.0f, dSq - t * t));
+		_w.push_back(w);
+		_totalW += w;
+		_extent = std::max(_extent, std::sqrt(double(dSq)));
+	};
+
+	const std::vector<Eigen::Vector4f> &points1 = av1.points();
+	const std::vector<Eigen::Vector4f> &points2 = av2.points();
+	if (points1.size() * points2.size() <= nsamples) {
+		_t.reserve(points1.size() * points2.size());
+		_q.reserve(_t.capacity());
+		_w.reserve(_t.capacity());
+		for (const Eigen::Vector4f &p1 : points1) {
+			for (const Eigen::Vector4f &p2 : points2) {
+				append(p1, p2, p1[3] * p2[3]);
+			}
+		}
+		return;
+	}
+	// drawn with the probability proportional to the weights, the pairs
+	// have equal weights
+	const std::vector<double> cumulative1 = cumulativeWeights(points1);
+	const std::vector<double> cumulative2 = cumulativeWeights(points2);
+	_t.reserve(nsamples);
+	_q.reserve(nsamples);
+	_w.reserve(nsamples);
+	for (unsigned k = 0; k < nsamples; ++k) {
+		const std::uint64_t r = counterRandom(seed, k);
+		const size_t i1 = samplePoint(cumulative1, r & 0xffffffffu);
+		const size_t i2 = samplePoint(cumulative2, r >> 32);
+		append(points1[i1], points2[i2], 1.0f);
+	}
+}
+
+std::pair<double, double> RmpConverter::evaluate(double Rmp) const
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	if (!valid()) {
+		return {nan, nan};
+	}
+	if (_type == Type::Rmp) {
+		return {Rmp, 1.0};
+	}
+	// sums of w*g(r) and of w*dg/dRmp, dr/dRmp=(Rmp+t)/r
+	double sum = 0.0, derivative = 0.0;
+	if (_type == Type::RDAMean) {
+		for (size_t k = 0; k < _t.size(); ++k) {
+			const double a = Rmp + _t[k];
+			const double r = std::sqrt(a * a + _q[k]);
+			sum += _w[k] * r;
+			derivative += r > 0.0 ? _w[k] * a / r : 0.0;
+		}
+		return {sum / _totalW, derivative / _totalW};
+	}
+	// E=1/(1+x^3), x=(r/R0)^2, dE/dRmp=-6*x^2*E^2*(Rmp+t)/R0^2
+	const double invR0Sq = 1.0 / (_R0 * _R0);
+	for (size_t k = 0; k < _t.size(); ++k) {
+		const double a = Rmp + _t[k];
+		const double x = (a * a + _q[k]) * invR0Sq;
+		const double e = 1.0 / (1.0 + x * x * x);
+		sum += _w[k] * e;
+		derivative -= _w[k] * 6.0 * x * x * e * e * a * invR0Sq;
+	}
+	const double e = sum / _totalW;
+	// Rdae=R0*(1/E-1)^(1/6), dRdae/dE=-Rdae/(6*E*(1-E))
+	const double rdae = _R0 * std::pow(1.0 / e - 1.0, 1.0 / 6.0);
+	const double dRdE = -rdae / (6.0 * e * (1.0 - e));
+	return {rdae, dRdE * derivative / _totalW};
+}
+
+double RmpConverter::Rmp(double modelDistance, double accuracy) const
+{
+	if (!valid() || !(modelDistance >= 0.0)) {
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	if (_type == Type::Rmp) {
+		return modelDistance;
+	}
+	// The model distance grows with Rmp. At Rmp=lo it is below the target
+	// and at Rmp=hi not, as no pair is closer than the target there. Newton
+	// steps outside of [lo,hi] are replaced by bisection.
+	double lo = 0.0, hi = modelDistance + _extent;
+	if (evaluate(lo).first >= modelDistance) {
+		return 0.0;
+	}
+	double rmp = std::min(modelDistance, hi);
+	for (int i = 0; i < 100 && hi - lo > 1e-6 * accuracy; ++i) {
+		const std::pair<double, double> f = evaluate(rmp);
+		const double diff = f.first - modelDistance;
+		if (std::abs(diff) <= accuracy) {
+			return rmp;
+		}
+		(diff < 0.0 ? lo : hi) = rmp;
+		const double next = rmp - diff / f.second;
+		rmp = next > lo && next < hi ? next : 0.5 * (lo + hi);
+	}
+	return rmp;
+}
@@ -0,0 +1,54 @@
+#ifndef RMPCONVERTER_H
+#define RMPCONVERTER_H
+
+#include "PositionSimulationResult.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Conversion between the distance of the mean positions (Rmp) of two AVs
+// and their model distance (RDAMean or RDAMeanE), with the shapes of the
+// AVs kept and the second one moved along the line through the mean
+// positions. The differences of the pairs of points relative to the mean
+// positions are computed once (all pairs for small AVs, otherwise a fixed
+// set of random pairs) and stored as the component t along the line and
+// the squared perpendicular component q, so that a pair is
+// sqrt((Rmp+t)^2+q) apart. The model distance is a smooth deterministic
+// function of Rmp then, which is inverted by Newton's method.
+class RmpConverter
+{
+public:
+	RmpConverter(const PositionSimulationResult &av1,
+		     const PositionSimulationResult &av2,
+		     const std::string &type, double R0,
+		     unsigned nsamples = 200000, std::uint64_t seed = 0);
+	// false for empty AVs or an unknown type
+	bool valid() const
+	{
+		return _type != Type::Unknown && _totalW > 0.0;
+	}
+	// model distance at the distance Rmp of the mean positions
+	double modelDistance(double Rmp) const
+	{
+		return evaluate(Rmp).first;
+	}
+	// Rmp, at which the model distance is modelDistance within accuracy,
+	// 0 if the model distance is larger even at Rmp=0
+	double Rmp(double modelDistance, double accuracy = 0.01) const;
+
+private:
+	// model distance and its derivative by Rmp
+	std::pair<double, double> evaluate(double Rmp) const;
+
+	enum class Type { Rmp, RDAMean, RDAMeanE, Unknown };
+	Type _type = Type::Unknown;
+	double _R0;
+	std::vector<float> _t, _q, _w;
+	double _totalW = 0.0;
+	// largest distance of a pair at Rmp=0
+	double _extent = 0.0;
+};
+
+#endif // RMPCONVERTER_H
@@ -0,0 +1,153 @@
+#include "SelectionCache.h"
+
+#include <algorithm>
+#include <iostream>
+#include <regex>
+
+namespace
+{
+// Whether the parentheses are balanced and no "or" is outside of them, so
+// that "expr and ..." is evaluated as (expr) and (...).
+bool conjunction(const std::string &expr)
+{
+	static const std::regex orWord("\\bor\\b");
+	int depth = 0;
+	std::string outside;
+	for (char c : expr) {
+		depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+		if (depth < 0) {
+			return false;
+		}
+		// the parenthesized parts are blanked out
+		outside += depth == 0 && c != ')' ? c : ' ';
+	}
+	return depth == 0 && !std::regex_search(outside, orWord);
+}
+
+// whether expr is a single parenthesized expression
+bool parenthesized(const std::string &expr)
+{
+	int depth = 0;
+	for (size_t i = 0; i < expr.size(); ++i) {
+		depth += expr[i] == '(' ? 1 : expr[i] == ')' ? -1 : 0;
+		if (depth == 0 && i + 1 < expr.size()) {
+			return false;
+		}
+	}
+	return expr.size() > 1 && expr.front() == '(' && depth == 0;
+}
+} // namespace
+
+SelectionCache::Indices SelectionCache::indices(const std::string &key,
+						const FrameData &frame,
+						const std::string &expr,
+						const AtomCellList *atoms)
+{
+	if (coordinateDependent(expr)) {
+		if (atoms && int(atoms->size()) == frame.numAtoms()) {
+			Indices selected =
+				selectWithin(key, frame, expr, *atoms);
+			if (selected) {
+				return selected;
+			}
+		}
+		// built once per frame and shared by all of its users
+		return select(frame.system(), expr);
+	}
+	const pteros::System &system = frame.topology();
+	if (key.empty()) {
+		return select(system, expr);
+	}
+	const auto entryKey = std::make_pair(key, expr);
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		auto it = _entries.find(entryKey);
+		if (it != _entries.end()
+		    && it->second.numAtoms == system.num_atoms()) {
+			return it->second.indices;
+		}
+	}
+	Indices selected = select(system, expr);
+	std::lock_guard<std::mutex> guard(_mutex);
+	// e.g. an ensemble of many single frame topologies
+	if (_entries.size() >= 4096) {
+		_entries.clear();
+	}
+	_entries[entryKey] = Entry{system.num_atoms(), selected};
+	return selected;
+}
+
+SelectionCache::Indices
+SelectionCache::selectWithin(const std::string &key, const FrameData &frame,
+			     const std::string &expr, const AtomCellList &atoms)
+{
+	// prefix, radius [nm], self/noself, (reference atoms)
+	static const std::regex within(
+		"^\\s*(?:(.*\\S)\\s+and\\s+)?within\\s+"
+		"([0-9]*\\.?[0-9]+(?:[eE][-+]?[0-9]+)?)\\s+"
+		"(?:(self|noself)\\s+)?of\\s*(\\(.*\\))\\s*$");
+	std::smatch match;
+	if (!std::regex_match(expr, match, within)) {
+		return nullptr;
+	}
+	const std::string prefix = match[1], reference = match[4];
+	if (!parenthesized(reference) || coordinateDependent(reference)
+	    || coordinateDependent(prefix) || !conjunction(prefix)) {
+		return nullptr;
+	}
+	const Indices centers = indices(key, frame, reference);
+	// the cell list is in Angstrom
+	const float radius = std::stof(match[2]) * 10.0f;
+	const std::vector<Eigen::Vector3f> &coords = frame.coords();
+	std::vector<char> near(coords.size(), 0);
+	for (int c : *centers) {
+		for (int i : atoms.indicesWithin(coords[c] * 10.0f, radius)) {
+			near[i] = 1;
+		}
+	}
+	const bool self = match[3] != "noself";
+	for (int c : *centers) {
+		near[c] = self;
+	}
+	auto selected = std::make_shared<std::vector<int>>();
+	if (prefix.empty()) {
+		for (size_t i = 0; i < near.size(); ++i) {
+			if (near[i]) {
+				selected->push_back(i);
+			}
+		}
+		return selected;
+	}
+	for (int i : *indices(key, frame, prefix)) {
+		if (near[i]) {
+			selected->push_back(i);
+		}
+	}
+	return selected;
+}
+
+void SelectionCache::clear()
+{
+	std::lock_guard<std::mutex> guard(_mutex);
+	_entries.clear();
+}
+
+bool SelectionCache::coordinateDependent(const std::string &expr)
+{
+	static const std::regex keywords(
+		"\\b(within|x|y|z|dist|distance|point|vector|plane)\\b");
+	return std::regex_search(expr, keywords);
+}
+
+SelectionCache::Indices SelectionCache::select(const pteros::System &system,
+					       const std::string &expr)
+{
+	pteros::Selection sel;
+	try {
+		sel.modify(system, expr);
+	} catch (const pteros::Pteros_error &err) {
+		std::cerr << err.what() << std::endl;
+		return std::make_shared<const std::vector<int>>();
+	}
+	return std::make_shared<const std::vector<int>>(sel.get_index());
+}
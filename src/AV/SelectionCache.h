@@ -0,0 +1,65 @@
+#ifndef SELECTIONCACHE_H
+#define SELECTIONCACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pteros/pteros.h"
+
+#include "AtomCellList.h"
+#include "FrameData.h"
+
+// Atom indices of pteros selections per (topology, selection expression).
+// The atoms selected by an expression, which does not depend on the
+// coordinates (names, residues, chains, ...), are the same for all frames of
+// a topology, so the expression is parsed and evaluated only once. A copy
+// starts empty, like AVHistoryCache.
+class SelectionCache
+{
+public:
+	using Indices = std::shared_ptr<const std::vector<int>>;
+
+	SelectionCache() = default;
+	SelectionCache(const SelectionCache & /*other*/)
+	{
+	}
+	SelectionCache &operator=(const SelectionCache & /*other*/)
+	{
+		clear();
+		return *this;
+	}
+	// Indices of the atoms of the frame, selected by expr, empty if expr
+	// is invalid. key identifies the topology of the frame (e.g. its file
+	// name), an empty key disables the caching. Expressions of the form
+	// "[static and] within R [self|noself] of (static)" are answered with
+	// the cell list atoms of the frame, if given, and the cached static
+	// parts.
+	Indices indices(const std::string &key, const FrameData &frame,
+			const std::string &expr,
+			const AtomCellList *atoms = nullptr);
+	void clear();
+	// whether the expression refers to the coordinates (within, x, ...)
+	// and has to be evaluated for every frame
+	static bool coordinateDependent(const std::string &expr);
+
+private:
+	static Indices select(const pteros::System &system,
+			      const std::string &expr);
+	// nullptr, if expr does not have the form above
+	Indices selectWithin(const std::string &key, const FrameData &frame,
+			     const std::string &expr,
+			     const AtomCellList &atoms);
+
+	struct Entry {
+		int numAtoms;
+		Indices indices;
+	};
+	std::mutex _mutex;
+	std::map<std::pair<std::string, std::string>, Entry> _entries;
+};
+
+#endif // SELECTIONCACHE_H
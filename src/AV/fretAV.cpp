@@ -1,14 +1,60 @@
 #include "AV/fretAV.h"
+#include "AV/OccupancyGrid.h"
 
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <queue>
-#include <set>
+#include <utility>
+#include <unordered_map>
+#include <cmath>
 #include <fstream>
+#include <limits>
 #include <iostream>
 
 #include <Eigen/Dense>
+#include <async++.h>
 
-using edge_t = std::pair<int, float>;
+struct edge_t {
+	int di;	      // 1-D offset in the path length grid
+	long bit;     // offset in the occupancy grid
+	float length; // in grid units
+};
+
+// Buffers, which are reused by consecutive AV calculations in the same
+// thread. They keep the capacity of the largest cube seen, so that the
+// steady state calculation does not need to allocate the grids again.
+struct AVWorkspace {
+	OccupancyGrid linker;
+	std::array<OccupancyGrid, 3> dye;
+	std::vector<float> clearance, pathL, clippedPathL;
+	// coarse-to-fine path length search
+	OccupancyGrid coarseLinker, search;
+	std::vector<float> coarsePathL;
+	std::vector<char> trusted, interior;
+	std::vector<int> trappedPointIndexes;
+	std::vector<Eigen::Vector4f> points;
+};
+
+AVWorkspace &avWorkspace()
+{
+	thread_local AVWorkspace workspace;
+	return workspace;
+}
+
+const std::vector<SphereStamp> &sphereStamps(const int maxRadius)
+{
+	// sphere stamps of radii 0..maxRadius, built once per thread
+	thread_local std::vector<SphereStamp> stamps;
+	while (int(stamps.size()) <= maxRadius) {
+		stamps.emplace_back(stamps.size());
+	}
+	return stamps;
+}
 
 inline int edgeL2center(int edgeL)
 {
@@ -22,36 +68,80 @@ inline int index(const int &x, const int &y, const int &z, const int &edgeL)
 	return z + edgeL * (y + x * edgeL);
 }
 
-inline int index(const Eigen::Vector4f &rf, const float &discretizationStep,
-		 const int &center, const int &edgeL)
+inline Eigen::Vector4i voxel(const Eigen::Vector4f &rf,
+			     const float &discretizationStep, const int &center)
 {
-	// convert real space 3-D coordinates to 1-D offest
+	// convert real space 3-D coordinates to grid coordinates
 	Eigen::Vector4i r = (rf / discretizationStep).cast<int>();
 	r += Eigen::Vector4i(center, center, center, 0);
-	return index(r[0], r[1], r[2], edgeL);
-}
-
-std::vector<edge_t> deltaIlist(const int &delta, const int &edgeL)
-{
-	// returns the list of 1-D represenataion offsets for the
-	// nearest 3D-neigbours within the radius of delta
-	std::vector<edge_t> diList;
-	const int maxSq = delta * delta;
-	diList.reserve(std::pow(delta, 3));
-	for (int dx = -delta; dx <= delta; ++dx) {
-		for (int dy = -delta; dy <= delta; ++dy) {
-			for (int dz = -delta; dz <= delta; ++dz) {
-				int dSq = (dx * dx + dy * dy + dz * dz);
-				if (dSq <= maxSq) {
-					int di = dz + edgeL * (dy + dx * edgeL);
-					diList.emplace_back(di,
-							    sqrt(float(dSq)));
-				}
-			}
+	return r;
+}
+
+int parallelSlabs(const int edgeL, const long parallelVoxels)
+{
+	// number of x slabs to split a grid into, 1 for the grids, which are
+	// too small to be worth processing by several threads
+	const long voxels = long(edgeL) * edgeL * edgeL;
+	if (parallelVoxels <= 0 || voxels < parallelVoxels) {
+		return 1;
+	}
+	const int threads = std::max(1u, std::thread::hardware_concurrency());
+	return std::min(4 * threads, edgeL);
+}
+
+async::threadpool_scheduler &slabScheduler()
+{
+	// The slab work does not go to the default pool: the evaluator tasks
+	// run there, and a waiting worker of a pool runs other tasks of that
+	// pool, e.g. another AV calculation, which would reuse the thread_local
+	// buffers of the one being split into slabs.
+	static async::threadpool_scheduler scheduler(
+		std::max(1u, std::thread::hardware_concurrency()));
+	return scheduler;
+}
+
+void blockingWait(async::task_wait_handle task)
+{
+	std::mutex mutex;
+	std::condition_variable finished;
+	bool ready = false;
+	task.on_finish([&] {
+		std::lock_guard<std::mutex> lock(mutex);
+		ready = true;
+		finished.notify_one();
+	});
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return ready; });
+}
+
+template <typename Func>
+void parallelFor(const int n, Func &&func)
+{
+	// func(i) for i in [0,n) on the slab scheduler. The calling thread
+	// only works on this loop and blocks, while it waits for the rest.
+	struct WaitHandlerGuard {
+		async::wait_handler previous =
+			async::set_thread_wait_handler(blockingWait);
+		~WaitHandlerGuard()
+		{
+			async::set_thread_wait_handler(previous);
 		}
+	} guard;
+	async::parallel_for(slabScheduler(), async::irange(0, n), func);
+}
+
+template <typename Func>
+void forSlabs(const int edgeL, const int numSlabs, Func &&func)
+{
+	// func(slab, xBegin, xEnd) for the x slabs [xBegin,xEnd) of the grid
+	if (numSlabs <= 1) {
+		func(0, 0, edgeL);
+		return;
 	}
-	diList.shrink_to_fit();
-	return diList;
+	parallelFor(numSlabs, [&](int slab) {
+		func(slab, edgeL * slab / numSlabs,
+		     edgeL * (slab + 1) / numSlabs);
+	});
 }
 
 float maxRadius(const std::vector<Eigen::Vector4f> &xyzR)
@@ -63,13 +153,16 @@ float maxRadius(const std::vector<Eigen::Vector4f> &xyzR)
 				  }))[3];
 }
 
-std::vector<bool> xyzr2occupancy(const std::vector<Eigen::Vector4f> &xyzR,
-				 const Eigen::Vector4f &rSource,
-				 const float &maxLength,
-				 const float &discretizationStep,
-				 const float extraClash = 0.0f)
+void xyzr2occupancy(OccupancyGrid &occupancy,
+		    const std::vector<Eigen::Vector4f> &xyzR,
+		    const Eigen::Vector4f &rSource, const float &maxLength,
+		    const float &discretizationStep,
+		    const float extraClash = 0.0f, const float reach = -1.0f,
+		    const long parallelVoxels = 0)
 {
 	// map xyzR to clash/occupancy map in discrete space
+	// atoms further away than maxLength+maxR+reach are skipped,
+	// negative reach means reach=extraClash
 	using Eigen::Vector4f;
 	using std::vector;
 	const float maxR = maxRadius(xyzR);
@@ -78,16 +171,18 @@ std::vector<bool> xyzr2occupancy(const std::vector<Eigen::Vector4f> &xyzR,
 		1 + std::lround((maxLength + maxR * 2.0f) / discretizationStep);
 	const int edgeL = 2 * iR + 1;
 	const int center = edgeL2center(edgeL);
-	const int vol = std::pow(edgeL, 3);
-	const float maxLengthSq = std::pow(maxLength + maxRe, 2.0f);
+	const float maxLengthSq = std::pow(
+		maxLength + maxR + (reach < 0.0f ? extraClash : reach), 2.0f);
 
-
-	vector<vector<edge_t>> deltaILists;
-	deltaILists.reserve(maxRe / discretizationStep + 1);
-	for (int di = 0; di <= maxRe / discretizationStep + 1; ++di) {
-		deltaILists.push_back(deltaIlist(di, edgeL));
-	}
-	std::vector<bool> occupancy(vol, false);
+	const vector<SphereStamp> &stamps =
+		sphereStamps(maxRe / discretizationStep + 1);
+	occupancy.reset(edgeL);
+	// voxel of each atom, the stamp radius is stored in [3]. The slab
+	// workers have their own thread_local buffers, so they need to get
+	// this one through a reference.
+	thread_local vector<Eigen::Vector4i> buffer;
+	vector<Eigen::Vector4i> &voxels = buffer;
+	voxels.clear();
 	for (const Vector4f &r0 : xyzR) {
 		Vector4f r = r0 - rSource;
 		r[3] = 0.0f;
@@ -95,172 +190,852 @@ std::vector<bool> xyzr2occupancy(const std::vector<Eigen::Vector4f> &xyzR,
 		if (rSq > maxLengthSq) {
 			continue;
 		}
-		int i0 = index(r, discretizationStep, center, edgeL);
-		int maxDi =
-			std::lround((r0[3] + extraClash) / discretizationStep);
-		for (const auto &pair : deltaILists[maxDi]) {
-			const int &di = pair.first;
-			int cur = i0 + di;
-			if (cur >= 0 && cur < vol) {
-				occupancy[cur] = true;
-			}
+		Eigen::Vector4i v = voxel(r, discretizationStep, center);
+		v[3] = std::lround((r0[3] + extraClash) / discretizationStep);
+		voxels.push_back(v);
+	}
+	const int slabs = parallelSlabs(edgeL, parallelVoxels);
+	if (slabs == 1) {
+		for (const Eigen::Vector4i &v : voxels) {
+			occupancy.fill(stamps[v[3]], v[0], v[1], v[2]);
 		}
+		return;
 	}
-	return occupancy;
+	forSlabs(edgeL, slabs, [&](int /*slab*/, int xBegin, int xEnd) {
+		for (const Eigen::Vector4i &v : voxels) {
+			if (v[0] + v[3] >= xBegin && v[0] - v[3] < xEnd) {
+				occupancy.fill(stamps[v[3]], v[0], v[1], v[2],
+					       xBegin, xEnd);
+			}
+		}
+	});
 }
 
-void ignoreSphere(std::vector<bool> &occupancy, const int &ignoreR)
+void ignoreSphere(OccupancyGrid &occupancy, const int &ignoreR)
 {
 	// remove obstacles closer than ignoreR<adius> from the center (source)
-	const int edgeL = std::lround(std::cbrt(occupancy.size()));
-	const int center = edgeL2center(edgeL);
-	const std::vector<edge_t> deltaIgnore = deltaIlist(ignoreR, edgeL);
-	int i0 = index(center, center, center, edgeL);
-	for (const auto &pair : deltaIgnore) {
-		const auto &di = pair.first;
-		int i = i0 + di;
-		occupancy[i] = false;
-	}
+	const int center = edgeL2center(occupancy.edgeL());
+	occupancy.clear(sphereStamps(ignoreR)[ignoreR], center, center, center);
 }
 
-void blockOutside(std::vector<bool> &occupancy, const int &maxR)
+void blockOutside(OccupancyGrid &occupancy, const int &maxR,
+		  const long parallelVoxels = 0)
 {
 	// block all vertices further away from source than maxR
 	const int maxRSq = maxR * maxR;
-	const int edgeL = std::lround(std::cbrt(occupancy.size()));
+	const int edgeL = occupancy.edgeL();
+	const int center = edgeL2center(edgeL);
+	const int slabs = parallelSlabs(edgeL, parallelVoxels);
+	forSlabs(edgeL, slabs, [&](int /*slab*/, int xBegin, int xEnd) {
+		for (int x = xBegin; x < xEnd; ++x) {
+			for (int y = 0; y < edgeL; ++y) {
+				const int rem = maxRSq
+						- (x - center) * (x - center)
+						- (y - center) * (y - center);
+				if (rem < 0) {
+					occupancy.fillRow(x, y);
+					continue;
+				}
+				int hw = std::sqrt(float(rem));
+				while (hw * hw > rem) {
+					--hw;
+				}
+				while ((hw + 1) * (hw + 1) <= rem) {
+					++hw;
+				}
+				occupancy.setRun(x, y, 0, center - hw - 1);
+				occupancy.setRun(x, y, center + hw + 1,
+						 edgeL - 1);
+			}
+		}
+	});
+}
+
+int clearanceMap(std::vector<float> &clearance,
+		 const std::vector<Eigen::Vector4f> &xyzR,
+		 const Eigen::Vector4f &rSource, const float &maxLength,
+		 const float &discretizationStep, const float &maxProbeR,
+		 const long parallelVoxels = 0)
+{
+	// Clearance (grid units) of each voxel to the v.d.Waals surface on the
+	// grid of xyzr2occupancy(), rounded the way its spheres are stamped:
+	// a voxel at distance d from the voxel of an atom of radius r is in the
+	// stamp for probeR, if lround((r+probeR)/step)>=ceil(d), that is if
+	// ceil(d)-0.5-r/step<=probeR/step. An atom, which xyzr2occupancy() only
+	// keeps for larger probes, does not count below that probe either.
+	// Voxels with no atom surface within maxProbeR are infinite.
+	// Returns the edge length of the grid.
+	using Eigen::Vector4f;
+	const float maxR = maxRadius(xyzR);
+	const int iR =
+		1 + std::lround((maxLength + maxR * 2.0f) / discretizationStep);
+	const int edgeL = 2 * iR + 1;
 	const int center = edgeL2center(edgeL);
+	const float inf = std::numeric_limits<float>::infinity();
+	clearance.assign(size_t(edgeL) * edgeL * edgeL, inf);
+
+	struct Atom {
+		Eigen::Vector4i v; // voxel, the stamp radius in [3]
+		float r, minProbe; // grid units
+	};
+	// see xyzr2occupancy() for the buffer
+	thread_local std::vector<Atom> buffer;
+	std::vector<Atom> &atoms = buffer;
+	atoms.clear();
+	int maxStamp = 0;
+	for (const Vector4f &r0 : xyzR) {
+		Vector4f r = r0 - rSource;
+		r[3] = 0.0f;
+		const float minProbe = r.norm() - maxLength - maxR;
+		if (minProbe > maxProbeR) {
+			continue;
+		}
+		Atom atom;
+		atom.v = voxel(r, discretizationStep, center);
+		atom.v[3] =
+			std::lround((r0[3] + maxProbeR) / discretizationStep);
+		atom.r = r0[3] / discretizationStep;
+		atom.minProbe = minProbe / discretizationStep;
+		maxStamp = std::max(maxStamp, atom.v[3]);
+		atoms.push_back(atom);
+	}
+	// ceil(sqrt(dSq)) - 0.5
+	std::vector<float> ceilRoot(maxStamp * maxStamp + 1);
+	for (int d = 0, dSq = 0; dSq < int(ceilRoot.size()); ++dSq) {
+		while (d * d < dSq) {
+			++d;
+		}
+		ceilRoot[dSq] = d - 0.5f;
+	}
+	const std::vector<SphereStamp> &stamps = sphereStamps(maxStamp);
+	auto stampAtom = [&](const Atom &atom, const int xBegin,
+			     const int xEnd) {
+		const Eigen::Vector4i &v = atom.v;
+		for (const SphereStamp::Run &run : stamps[v[3]].runs()) {
+			const int x = v[0] + run.dx, y = v[1] + run.dy;
+			if (x < xBegin || x >= xEnd || y < 0 || y >= edgeL) {
+				continue;
+			}
+			const int zBegin = std::max(0, v[2] - run.halfWidth);
+			const int zEnd =
+				std::min(edgeL - 1, v[2] + run.halfWidth);
+			const int dxySq = run.dx * run.dx + run.dy * run.dy;
+			float *row = clearance.data() + index(x, y, 0, edgeL);
+			for (int z = zBegin; z <= zEnd; ++z) {
+				const int dz = z - v[2];
+				const float c = std::max(
+					ceilRoot[dxySq + dz * dz] - atom.r,
+					atom.minProbe);
+				row[z] = std::min(row[z], c);
+			}
+		}
+	};
+	const int slabs = parallelSlabs(edgeL, parallelVoxels);
+	forSlabs(edgeL, slabs, [&](int /*slab*/, int xBegin, int xEnd) {
+		for (const Atom &atom : atoms) {
+			if (atom.v[0] + atom.v[3] >= xBegin
+			    && atom.v[0] - atom.v[3] < xEnd) {
+				stampAtom(atom, xBegin, xEnd);
+			}
+		}
+	});
+	return edgeL;
+}
+
+void threshold(OccupancyGrid &occupancy, const std::vector<float> &clearance,
+	       const int edgeL, const float probeR)
+{
+	// voxels, which a probe of radius probeR (grid units) clashes with
+	occupancy.reset(edgeL);
 	int i = 0;
 	for (int x = 0; x < edgeL; ++x) {
 		for (int y = 0; y < edgeL; ++y) {
-			for (int z = 0; z < edgeL; ++z) {
-				int dSq = (x - center) * (x - center)
-					  + (y - center) * (y - center)
-					  + (z - center) * (z - center);
-				if (dSq > maxRSq) {
-					occupancy[i] = true;
+			for (int z = 0; z < edgeL; ++z, ++i) {
+				if (clearance[i] <= probeR) {
+					occupancy.set(x, y, z);
 				}
-				++i;
 			}
 		}
 	}
 }
 
-std::vector<edge_t> essentialEdges(const int &edgeL)
+// Clash grids of the same atoms for different probe radii
+class ClashMaps
 {
-	// returns the list of 1-D edge_index_offsets which matter
-	// for the path length determination (Dijkstra) algorithm.
-	// The shorter this list is, the faster Dijstra algorithm will run
-	// at the cost of lower path length precision.
-	// For example, including edges to only 6 nearest neighbours will result
-	// in isopath surfaces that are cubic instead of spherical.
-	std::vector<edge_t> fullList = deltaIlist(3, edgeL);
-	std::set<float> allowedDist;
-	for (float dSq : {1.0f, 2.0f, 3.0f, 5.0f, 6.0f}) { // good compromise
-		allowedDist.insert(sqrt(float(dSq)));
+public:
+	ClashMaps(const std::vector<Eigen::Vector4f> &xyzR,
+		  const Eigen::Vector4f &rSource, const float maxLength,
+		  const float discretizationStep, const float maxProbeR,
+		  const AVOptions &options, AVWorkspace &workspace)
+	    : _xyzR(xyzR), _rSource(rSource), _maxLength(maxLength),
+	      _step(discretizationStep), _backend(options.occupancyBackend),
+	      _parallelVoxels(options.parallelVoxels),
+	      _clearance(workspace.clearance)
+	{
+		if (_backend == OccupancyBackend::DistanceTransform) {
+			_edgeL = clearanceMap(_clearance, xyzR, rSource,
+					      maxLength, _step, maxProbeR,
+					      _parallelVoxels);
+		}
 	}
-	std::vector<edge_t> diList;
-	for (const edge_t &e : fullList) {
-		if (allowedDist.count(e.second) > 0) {
-			diList.push_back(e);
+	void occupancy(OccupancyGrid &grid, const float probeR) const
+	{
+		if (_backend == OccupancyBackend::DistanceTransform) {
+			threshold(grid, _clearance, _edgeL, probeR / _step);
+			return;
 		}
+		xyzr2occupancy(grid, _xyzR, _rSource, _maxLength, _step,
+			       probeR, -1.0f, _parallelVoxels);
 	}
-	diList.shrink_to_fit();
-	return diList;
+
+private:
+	const std::vector<Eigen::Vector4f> &_xyzR;
+	const Eigen::Vector4f _rSource;
+	const float _maxLength, _step;
+	const OccupancyBackend _backend;
+	const long _parallelVoxels;
+	int _edgeL = 0;
+	std::vector<float> &_clearance;
+};
+
+// Bit dSq of a shell set is set, if the neighbours with
+// dx*dx+dy*dy+dz*dz==dSq are connected by an edge.
+constexpr unsigned stencilShells(const PathStencil stencil)
+{
+	switch (stencil) {
+	case PathStencil::Neighbours6:
+		return 1u << 1;
+	case PathStencil::Neighbours18:
+		return 1u << 1 | 1u << 2;
+	case PathStencil::Neighbours26:
+		return 1u << 1 | 1u << 2 | 1u << 3;
+	case PathStencil::Neighbours50:
+		return 1u << 1 | 1u << 2 | 1u << 3 | 1u << 5;
+	case PathStencil::Neighbours74:
+		return 1u << 1 | 1u << 2 | 1u << 3 | 1u << 5 | 1u << 6;
+	}
+	return 0u;
 }
 
-inline void setNeigbours(std::vector<edge_t> &neis, const int &source,
-			 const std::vector<bool> &occupancy,
-			 const std::vector<edge_t> &allEssential)
+// the longest supported edge (sqrt(6)) spans 2 voxels per axis
+constexpr int stencilReach = 2;
+
+constexpr int stencilSize(const unsigned shells)
 {
-	// from potential relevant(essential) neighbours select those
-	// which are not blocked by obstacles
-	neis.clear();
-	for (edge_t n : allEssential) {
-		n.first += source;
-		if (!occupancy[n.first]) {
-			neis.push_back(std::move(n));
+	int size = 0;
+	for (int dx = -stencilReach; dx <= stencilReach; ++dx) {
+		for (int dy = -stencilReach; dy <= stencilReach; ++dy) {
+			for (int dz = -stencilReach; dz <= stencilReach; ++dz) {
+				const int dSq = dx * dx + dy * dy + dz * dz;
+				size += (shells >> dSq) & 1u;
+			}
 		}
 	}
+	return size;
 }
 
-std::vector<float> pathLength(const std::vector<bool> &occupancyVdWL)
+struct StencilOffset {
+	int dx = 0, dy = 0, dz = 0;
+};
+
+// Neighbour offsets of a shell set, computed at compile time
+template <unsigned shells> struct StencilOffsets {
+	static constexpr int size = stencilSize(shells);
+	StencilOffset offsets[size];
+	constexpr StencilOffsets() : offsets()
+	{
+		int i = 0;
+		for (int dx = -stencilReach; dx <= stencilReach; ++dx) {
+			for (int dy = -stencilReach; dy <= stencilReach; ++dy) {
+				for (int dz = -stencilReach; dz <= stencilReach;
+				     ++dz) {
+					const int dSq =
+						dx * dx + dy * dy + dz * dz;
+					if ((shells >> dSq) & 1u) {
+						offsets[i].dx = dx;
+						offsets[i].dy = dy;
+						offsets[i].dz = dz;
+						++i;
+					}
+				}
+			}
+		}
+	}
+};
+
+template <unsigned shells>
+using StencilEdges = std::array<edge_t, StencilOffsets<shells>::size>;
+
+template <unsigned shells>
+const StencilEdges<shells> &stencilEdges(const OccupancyGrid &grid)
 {
-	// perform dijkstra algorithm
-	using Eigen::Vector4f;
-	using std::vector;
+	// The edges of a shell set, which matter for the path length
+	// determination (Dijkstra) algorithm. The fewer edges, the faster the
+	// search, at the cost of lower path length precision. For example,
+	// including edges to only 6 nearest neighbours will result in isopath
+	// surfaces that are cubic instead of spherical.
+	// The offsets only depend on the cube size, cache them per thread.
+	thread_local std::unordered_map<int, StencilEdges<shells>> cache;
+	auto it = cache.find(grid.edgeL());
+	if (it != cache.end()) {
+		return it->second;
+	}
+	constexpr StencilOffsets<shells> stencil;
+	const int edgeL = grid.edgeL();
+	StencilEdges<shells> edges;
+	for (size_t i = 0; i < edges.size(); ++i) {
+		const StencilOffset &o = stencil.offsets[i];
+		const int dSq = o.dx * o.dx + o.dy * o.dy + o.dz * o.dz;
+		edges[i] = {index(o.dx, o.dy, o.dz, edgeL),
+			    grid.bitOffset(o.dx, o.dy, o.dz),
+			    std::sqrt(float(dSq))};
+	}
+	return cache.emplace(edgeL, edges).first->second;
+}
 
-	const int edgeL = std::lround(std::cbrt(occupancyVdWL.size()));
-	const int center = edgeL2center(edgeL);
-	const vector<edge_t> &allEssentialEdges = essentialEdges(edgeL);
-	int sourceVertex = index(center, center, center, edgeL);
-	vector<float> pathL(occupancyVdWL.size(),
-			    std::numeric_limits<float>::max());
-	pathL[sourceVertex] = 0;
+template <unsigned shells>
+const std::vector<edge_t> &stencilEdgeList(const OccupancyGrid &grid)
+{
+	thread_local std::unordered_map<int, std::vector<edge_t>> cache;
+	auto it = cache.find(grid.edgeL());
+	if (it == cache.end()) {
+		const StencilEdges<shells> &edges = stencilEdges<shells>(grid);
+		std::vector<edge_t> list(edges.begin(), edges.end());
+		it = cache.emplace(grid.edgeL(), std::move(list)).first;
+	}
+	return it->second;
+}
 
+const std::vector<edge_t> &essentialEdges(const OccupancyGrid &grid,
+					  const PathStencil stencil)
+{
+	// same edges as used by the search kernels, as a run-time list
+	switch (stencil) {
+	case PathStencil::Neighbours6:
+		return stencilEdgeList<stencilShells(
+			PathStencil::Neighbours6)>(grid);
+	case PathStencil::Neighbours18:
+		return stencilEdgeList<stencilShells(
+			PathStencil::Neighbours18)>(grid);
+	case PathStencil::Neighbours26:
+		return stencilEdgeList<stencilShells(
+			PathStencil::Neighbours26)>(grid);
+	case PathStencil::Neighbours50:
+		return stencilEdgeList<stencilShells(
+			PathStencil::Neighbours50)>(grid);
+	case PathStencil::Neighbours74:
+		break;
+	}
+	return stencilEdgeList<stencilShells(PathStencil::Neighbours74)>(grid);
+}
 
-	using queue_entry_t = std::pair<float, int>;
+template <typename Edges, typename Relax, size_t... I>
+inline void forEachEdge(const Edges &edges, Relax &&relax,
+			std::index_sequence<I...>)
+{
+	// fully unrolled loop over a fixed size stencil
+	const int unrolled[] = {(relax(edges[I]), 0)...};
+	static_cast<void>(unrolled);
+}
 
-	std::vector<queue_entry_t> queContainer;
-	queContainer.reserve(8192);
-	std::priority_queue<queue_entry_t, std::vector<queue_entry_t>,
-			    std::greater<queue_entry_t>>
-		que(std::greater<queue_entry_t>(), std::move(queContainer));
+template <typename Edges, typename Relax>
+inline void forEachEdge(const Edges &edges, Relax &&relax)
+{
+	forEachEdge(edges, relax,
+		    std::make_index_sequence<std::tuple_size<Edges>::value>());
+}
 
-	// it is possible to improve performance 10-20%
-	// by using more efficient heap/queue implementation like radix heap
+class BinaryHeapQueue
+{
+public:
+	using entry_t = std::pair<float, int>;
+	void reset(const std::vector<edge_t> & /*edges*/, float /*start*/ = 0.0f,
+		   float /*end*/ = 0.0f)
+	{
+		_heap.clear();
+		_heap.reserve(8192);
+	}
+	bool empty() const
+	{
+		return _heap.empty();
+	}
+	void push(const float &dist, const int &vertex)
+	{
+		_heap.emplace_back(dist, vertex);
+		std::push_heap(_heap.begin(), _heap.end(),
+			       std::greater<entry_t>());
+	}
+	entry_t pop()
+	{
+		std::pop_heap(_heap.begin(), _heap.end(),
+			      std::greater<entry_t>());
+		const entry_t top = _heap.back();
+		_heap.pop_back();
+		return top;
+	}
+
+private:
+	// min-heap, kept in a plain vector to be able to clear it
+	std::vector<entry_t> _heap;
+};
 
-	// std::priority_queue<queue_entry_t, vector<queue_entry_t>,
-	// std::greater<queue_entry_t>> que;
-	que.emplace(0.0f, sourceVertex);
-	std::vector<edge_t> neigbours;
+class BucketQueue
+{
+	// Monotone bucket queue (Dial's algorithm). The width of a bucket is
+	// equal to the shortest edge, so relaxation of a vertex from the
+	// current bucket can never insert into the current bucket. Hence, all
+	// vertices of the current bucket are final and can be popped in any
+	// order, which gives exactly the same path lengths as a binary heap.
+	// Only ceil(longest/shortest)+1 buckets can be non-empty at any time
+	// (more, if the initially pushed distances span a wider range), so
+	// they are reused cyclically.
+public:
+	using entry_t = std::pair<float, int>;
+	// start, end: the smallest and the largest distance of the initially
+	// pushed vertices
+	void reset(const std::vector<edge_t> &edges, float start = 0.0f,
+		   float end = 0.0f)
+	{
+		float minW = std::numeric_limits<float>::max();
+		float maxW = 0.0f;
+		for (const edge_t &e : edges) {
+			if (e.length > 0.0f) {
+				minW = std::min(minW, e.length);
+				maxW = std::max(maxW, e.length);
+			}
+		}
+		_invWidth = 1.0f / minW;
+		const float span = std::max(maxW, end - start);
+		int numBuckets = 1;
+		while (numBuckets < std::ceil(span / minW) + 1) {
+			numBuckets *= 2;
+		}
+		_mask = numBuckets - 1;
+		_buckets.resize(numBuckets);
+		for (auto &bucket : _buckets) {
+			bucket.clear();
+			bucket.reserve(2048);
+		}
+		_current = int(start * _invWidth);
+		_size = 0;
+	}
+	bool empty() const
+	{
+		return _size == 0;
+	}
+	void push(const float &dist, const int &vertex)
+	{
+		const int ibucket = int(dist * _invWidth);
+		_buckets[ibucket & _mask].emplace_back(dist, vertex);
+		++_size;
+	}
+	entry_t pop()
+	{
+		while (_buckets[_current & _mask].empty()) {
+			++_current;
+		}
+		auto &bucket = _buckets[_current & _mask];
+		const entry_t top = bucket.back();
+		bucket.pop_back();
+		--_size;
+		return top;
+	}
+
+private:
+	std::vector<std::vector<entry_t>> _buckets;
+	float _invWidth = 1.0f;
+	int _mask = 0;
+	int _current = 0;
+	size_t _size = 0;
+};
+
+template <typename Queue, unsigned shells>
+void dijkstra(const OccupancyGrid &occupancyVdWL, std::vector<float> &pathL,
+	      const std::vector<int> &seeds)
+{
+	// perform dijkstra algorithm, starting from the seed vertices with
+	// known path lengths
+	using Eigen::Vector4f;
+	using std::vector;
+	if (seeds.empty()) {
+		return;
+	}
+	const StencilEdges<shells> &edges = stencilEdges<shells>(occupancyVdWL);
+	const vector<edge_t> &allEssentialEdges =
+		stencilEdgeList<shells>(occupancyVdWL);
+	float start = std::numeric_limits<float>::max(), end = 0.0f;
+	for (const int v : seeds) {
+		start = std::min(start, pathL[v]);
+		end = std::max(end, pathL[v]);
+	}
+
+	using queue_entry_t = typename Queue::entry_t;
+	thread_local Queue que;
+	que.reset(allEssentialEdges, start, end);
+	for (const int v : seeds) {
+		que.push(pathL[v], v);
+	}
 	while (!que.empty()) {
-		const queue_entry_t qt = que.top();
-		que.pop();
+		const queue_entry_t qt = que.pop();
 		if (qt.first > pathL[qt.second])
 			continue;
-		setNeigbours(neigbours, qt.second, occupancyVdWL,
-			     allEssentialEdges);
-		for (const edge_t &e : neigbours) {
-			queue_entry_t t;
-			t.second = e.first;	    // tv
-			t.first = qt.first + e.second; // tp
-			if (t.first < pathL[t.second]) {
-				pathL[t.second] = t.first;
-				que.push(std::move(t));
+		const long bit = occupancyVdWL.bitFromIndex(qt.second);
+		forEachEdge(edges, [&](const edge_t &e) {
+			if (occupancyVdWL.test(bit + e.bit)) {
+				return;
+			}
+			const int tv = qt.second + e.di;
+			const float tp = qt.first + e.length;
+			if (tp < pathL[tv]) {
+				pathL[tv] = tp;
+				que.push(tp, tv);
+			}
+		});
+	}
+}
+
+inline bool atomicMin(float &target, const float value)
+{
+	// lowers target to value, returns true if it was larger
+	float current;
+	__atomic_load(&target, &current, __ATOMIC_RELAXED);
+	while (value < current) {
+		float desired = value;
+		if (__atomic_compare_exchange(&target, &current, &desired, true,
+					      __ATOMIC_RELAXED,
+					      __ATOMIC_RELAXED)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <unsigned shells>
+void deltaStepping(const OccupancyGrid &occupancyVdWL,
+		   std::vector<float> &pathL, const std::vector<int> &seeds)
+{
+	// Parallel version of dijkstra<BucketQueue>() (delta-stepping with
+	// delta equal to the shortest edge). Relaxations never insert into the
+	// current bucket, so all of its vertices are final and are relaxed
+	// concurrently. Path lengths are lowered by compare-and-swap, each one
+	// ends up as the minimum over the same candidates as in the
+	// sequential search, so the results are identical.
+	using entry_t = std::pair<float, int>;
+	using std::vector;
+	if (seeds.empty()) {
+		return;
+	}
+	const StencilEdges<shells> &edges = stencilEdges<shells>(occupancyVdWL);
+	float minW = std::numeric_limits<float>::max(), maxW = 0.0f;
+	for (const edge_t &e : edges) {
+		minW = std::min(minW, e.length);
+		maxW = std::max(maxW, e.length);
+	}
+	float start = std::numeric_limits<float>::max(), end = 0.0f;
+	for (const int v : seeds) {
+		start = std::min(start, pathL[v]);
+		end = std::max(end, pathL[v]);
+	}
+	const float invWidth = 1.0f / minW;
+	int numBuckets = 1;
+	while (numBuckets < std::ceil(std::max(maxW, end - start) / minW) + 1) {
+		numBuckets *= 2;
+	}
+	const int mask = numBuckets - 1;
+	vector<vector<entry_t>> buckets(numBuckets);
+	for (const int v : seeds) {
+		buckets[int(pathL[v] * invWidth) & mask].emplace_back(pathL[v],
+								      v);
+	}
+	size_t pending = seeds.size();
+	const int threads = std::max(1u, std::thread::hardware_concurrency());
+	const int numChunks = 4 * threads;
+	vector<vector<entry_t>> found(numChunks);
+	vector<entry_t> frontier;
+	auto relax = [&](size_t from, size_t to, vector<entry_t> &out) {
+		for (size_t i = from; i < to; ++i) {
+			const entry_t &qt = frontier[i];
+			float current;
+			__atomic_load(&pathL[qt.second], &current,
+				      __ATOMIC_RELAXED);
+			if (qt.first > current) {
+				continue;
+			}
+			const long bit = occupancyVdWL.bitFromIndex(qt.second);
+			forEachEdge(edges, [&](const edge_t &e) {
+				if (occupancyVdWL.test(bit + e.bit)) {
+					return;
+				}
+				const int tv = qt.second + e.di;
+				const float tp = qt.first + e.length;
+				if (atomicMin(pathL[tv], tp)) {
+					out.emplace_back(tp, tv);
+				}
+			});
+		}
+	};
+	for (int current = int(start * invWidth); pending > 0; ++current) {
+		frontier.clear();
+		frontier.swap(buckets[current & mask]);
+		pending -= frontier.size();
+		if (frontier.size() < 1024) {
+			relax(0, frontier.size(), found[0]);
+		} else {
+			parallelFor(numChunks, [&](int chunk) {
+				relax(frontier.size() * chunk / numChunks,
+				      frontier.size() * (chunk + 1) / numChunks,
+				      found[chunk]);
+			});
+		}
+		for (vector<entry_t> &chunk : found) {
+			for (const entry_t &qt : chunk) {
+				buckets[int(qt.first * invWidth) & mask]
+					.push_back(qt);
+			}
+			pending += chunk.size();
+			chunk.clear();
+		}
+	}
+}
+
+template <unsigned shells>
+void dijkstra(const OccupancyGrid &occupancyVdWL, const AVOptions &options,
+	      std::vector<float> &pathL, const std::vector<int> &seeds)
+{
+	if (parallelSlabs(occupancyVdWL.edgeL(), options.parallelVoxels) > 1) {
+		deltaStepping<shells>(occupancyVdWL, pathL, seeds);
+		return;
+	}
+	switch (options.pathEngine) {
+	case PathLengthEngine::BinaryHeap:
+		dijkstra<BinaryHeapQueue, shells>(occupancyVdWL, pathL, seeds);
+		return;
+	case PathLengthEngine::BucketQueue:
+		dijkstra<BucketQueue, shells>(occupancyVdWL, pathL, seeds);
+		return;
+	}
+	dijkstra<BinaryHeapQueue, shells>(occupancyVdWL, pathL, seeds);
+}
+
+void dijkstra(const OccupancyGrid &occupancyVdWL, const AVOptions &options,
+	      std::vector<float> &pathL, const std::vector<int> &seeds)
+{
+	// every stencil has its own search kernel with the neighbour loop
+	// unrolled at compile time
+	switch (options.stencil) {
+	case PathStencil::Neighbours6:
+		dijkstra<stencilShells(PathStencil::Neighbours6)>(
+			occupancyVdWL, options, pathL, seeds);
+		return;
+	case PathStencil::Neighbours18:
+		dijkstra<stencilShells(PathStencil::Neighbours18)>(
+			occupancyVdWL, options, pathL, seeds);
+		return;
+	case PathStencil::Neighbours26:
+		dijkstra<stencilShells(PathStencil::Neighbours26)>(
+			occupancyVdWL, options, pathL, seeds);
+		return;
+	case PathStencil::Neighbours50:
+		dijkstra<stencilShells(PathStencil::Neighbours50)>(
+			occupancyVdWL, options, pathL, seeds);
+		return;
+	case PathStencil::Neighbours74:
+		break;
+	}
+	dijkstra<stencilShells(PathStencil::Neighbours74)>(occupancyVdWL,
+							   options, pathL,
+							   seeds);
+}
+
+void pathLength(const OccupancyGrid &occupancyVdWL, const AVOptions &options,
+		std::vector<float> &pathL)
+{
+	const int edgeL = occupancyVdWL.edgeL();
+	const int center = edgeL2center(edgeL);
+	const int sourceVertex = index(center, center, center, edgeL);
+	pathL.assign(occupancyVdWL.size(), std::numeric_limits<float>::max());
+	pathL[sourceVertex] = 0;
+	dijkstra(occupancyVdWL, options, pathL, {sourceVertex});
+}
+
+void updatePathLength(const OccupancyGrid &oldOccupancy,
+		      const OccupancyGrid &newOccupancy,
+		      const AVOptions &options, std::vector<float> &pathL)
+{
+	// Update the path lengths of oldOccupancy for the new obstacles.
+	// Let T be the smallest of
+	//  * the old path length of a newly blocked vertex and
+	//  * the old path length of a neighbour of a newly freed vertex plus
+	//    the shortest edge.
+	// Path lengths below T can neither get longer (their shortest paths
+	// do not touch blocked vertices) nor shorter (a path through a freed
+	// vertex is at least T long), so only the vertices at >=T have to be
+	// searched again. They are reached from the vertices in [T-maxW,T).
+	const std::vector<edge_t> &edges =
+		essentialEdges(newOccupancy, options.stencil);
+	float minW = std::numeric_limits<float>::max(), maxW = 0.0f;
+	for (const edge_t &e : edges) {
+		minW = std::min(minW, e.length);
+		maxW = std::max(maxW, e.length);
+	}
+	thread_local std::vector<int> changed;
+	newOccupancy.differences(oldOccupancy, changed);
+	if (changed.empty()) {
+		return;
+	}
+	const float inf = std::numeric_limits<float>::max();
+	const long size = pathL.size();
+	float T = inf;
+	for (const int v : changed) {
+		if (newOccupancy.test(newOccupancy.bitFromIndex(v))) {
+			T = std::min(T, pathL[v]);
+			continue;
+		}
+		for (const edge_t &e : edges) {
+			const long u = long(v) + e.di;
+			if (u >= 0 && u < size && pathL[u] < inf) {
+				T = std::min(T, pathL[u] + minW);
 			}
 		}
 	}
-	return std::move(pathL);
+	if (T == inf) {
+		return; // nothing reachable has changed
+	}
+	thread_local std::vector<int> seeds;
+	seeds.clear();
+	for (size_t v = 0; v < pathL.size(); ++v) {
+		if (pathL[v] >= T) {
+			pathL[v] = inf;
+		} else if (pathL[v] >= T - maxW) {
+			seeds.push_back(v);
+		}
+	}
+	dijkstra(newOccupancy, options, pathL, seeds);
+}
+
+PathLengthEngine pathLengthEngine(const std::string &name)
+{
+	if (name == "binary_heap") {
+		return PathLengthEngine::BinaryHeap;
+	} else if (name == "bucket_queue") {
+		return PathLengthEngine::BucketQueue;
+	}
+	std::cerr << "path length engine is not supported: " + name
+			     + ", using bucket_queue\n"
+		  << std::flush;
+	return PathLengthEngine::BucketQueue;
+}
+
+std::string pathLengthEngineName(const PathLengthEngine &engine)
+{
+	switch (engine) {
+	case PathLengthEngine::BinaryHeap:
+		return "binary_heap";
+	case PathLengthEngine::BucketQueue:
+		return "bucket_queue";
+	}
+	return "bucket_queue";
+}
+
+PathStencil pathStencil(const std::string &name)
+{
+	if (name == "6") {
+		return PathStencil::Neighbours6;
+	} else if (name == "18") {
+		return PathStencil::Neighbours18;
+	} else if (name == "26") {
+		return PathStencil::Neighbours26;
+	} else if (name == "50") {
+		return PathStencil::Neighbours50;
+	} else if (name == "74") {
+		return PathStencil::Neighbours74;
+	}
+	std::cerr << "path stencil is not supported: " + name
+			     + ", using 74\n"
+		  << std::flush;
+	return PathStencil::Neighbours74;
+}
+
+std::string pathStencilName(const PathStencil &stencil)
+{
+	switch (stencil) {
+	case PathStencil::Neighbours6:
+		return "6";
+	case PathStencil::Neighbours18:
+		return "18";
+	case PathStencil::Neighbours26:
+		return "26";
+	case PathStencil::Neighbours50:
+		return "50";
+	case PathStencil::Neighbours74:
+		return "74";
+	}
+	return "74";
+}
+
+OccupancyBackend occupancyBackend(const std::string &name)
+{
+	if (name == "raster") {
+		return OccupancyBackend::Raster;
+	} else if (name == "distance_transform") {
+		return OccupancyBackend::DistanceTransform;
+	}
+	std::cerr << "occupancy backend is not supported: " + name
+			     + ", using raster\n"
+		  << std::flush;
+	return OccupancyBackend::Raster;
+}
+
+std::string occupancyBackendName(const OccupancyBackend &backend)
+{
+	switch (backend) {
+	case OccupancyBackend::Raster:
+		return "raster";
+	case OccupancyBackend::DistanceTransform:
+		return "distance_transform";
+	}
+	return "raster";
 }
 
 std::vector<Eigen::Vector4f>
 path2points(const std::vector<float> &pathL,
-	    const std::vector<bool> &occupancyVdWDye,
+	    const OccupancyGrid &occupancyVdWDye,
 	    const Eigen::Vector4f &rSource, const float &maxRealLength,
 	    const float &discretizationStep, const float contactR,
-	    const float trappedFrac, const TabulatedFunction &weighting)
+	    const float trappedFrac, const TabulatedFunction &weighting,
+	    const long parallelVoxels = 0)
 {
 	// check dye Clashes and convert weights grid to a point array
 	using Eigen::Vector4f;
 	using std::vector;
-	const int edgeL = std::lround(std::cbrt(pathL.size()));
+	const int edgeL = occupancyVdWDye.edgeL();
 	const int vol = std::pow(edgeL, 3);
 	const int center = edgeL2center(edgeL);
 
-	const auto contactNeis =
-		deltaIlist(contactR / discretizationStep, edgeL);
-	vector<int> trappedPointIndexes;
+	const int contactDi = contactR / discretizationStep;
+	const SphereStamp &contactNeis = sphereStamps(contactDi)[contactDi];
+	AVWorkspace &workspace = avWorkspace();
+	vector<int> &trappedPointIndexes = workspace.trappedPointIndexes;
+	trappedPointIndexes.clear();
 	trappedPointIndexes.reserve(vol / 8);
 
 	const float maxVerthexL = maxRealLength / discretizationStep;
-	vector<Vector4f> points;
+	vector<Vector4f> &points = workspace.points;
+	points.clear();
 	points.reserve(vol / 4);
-	int vertex = 0;
-	for (int x = 0; x < edgeL; ++x) {
-		for (int y = 0; y < edgeL; ++y) {
-			for (int z = 0; z < edgeL; ++z, ++vertex) {
-				if (pathL[vertex] <= maxVerthexL
-				    && occupancyVdWDye[vertex] == false) {
+	auto collect = [&](int xBegin, int xEnd, vector<Vector4f> &points,
+			   vector<int> &trappedPointIndexes) {
+		int vertex = xBegin * edgeL * edgeL;
+		for (int x = xBegin; x < xEnd; ++x) {
+			for (int y = 0; y < edgeL; ++y) {
+				const long rowBit =
+					occupancyVdWDye.bit(x, y, 0);
+				for (int z = 0; z < edgeL; ++z, ++vertex) {
+					if (pathL[vertex] > maxVerthexL
+					    || occupancyVdWDye.test(rowBit
+								    + z)) {
+						continue;
+					}
 					Vector4f r(x - center, y - center,
 						   z - center, 0.0f);
 					r *= discretizationStep;
@@ -269,24 +1044,36 @@ path2points(const std::vector<float> &pathL,
 						      * discretizationStep;
 					r[3] = weighting.value(realL);
 					points.push_back(std::move(r));
-					for (const auto &pair : contactNeis) {
-						const int &di = pair.first;
-						const int nei = vertex + di;
-						if (nei >= 0 && nei < vol) {
-							if (occupancyVdWDye[nei]
-							    == true) {
-								// r[3]=contactW;
-								trappedPointIndexes
-									.emplace_back(
-										points.size()
-										- 1);
-								break;
-							}
-						}
+					if (occupancyVdWDye.any(contactNeis, x,
+								y, z)) {
+						// r[3]=contactW;
+						trappedPointIndexes.emplace_back(
+							points.size() - 1);
 					}
 				}
 			}
 		}
+	};
+	const int slabs = parallelSlabs(edgeL, parallelVoxels);
+	if (slabs == 1) {
+		collect(0, edgeL, points, trappedPointIndexes);
+	} else {
+		// slabs are concatenated in order, same as the sequential
+		// loop
+		vector<vector<Vector4f>> slabPoints(slabs);
+		vector<vector<int>> slabTrapped(slabs);
+		forSlabs(edgeL, slabs, [&](int slab, int xBegin, int xEnd) {
+			collect(xBegin, xEnd, slabPoints[slab],
+				slabTrapped[slab]);
+		});
+		for (int slab = 0; slab < slabs; ++slab) {
+			const int offset = points.size();
+			for (const int i : slabTrapped[slab]) {
+				trappedPointIndexes.push_back(offset + i);
+			}
+			points.insert(points.end(), slabPoints[slab].begin(),
+				      slabPoints[slab].end());
+		}
 	}
 	if (points.size() > 0 && contactR > 0.0 && trappedFrac >= 0.0) {
 		const float freeFrac = 1.0f - trappedFrac;
@@ -309,23 +1096,23 @@ path2points(const std::vector<float> &pathL,
 				  << std::flush;
 		}
 	}
-	return points;
+	// the buffer stays in the workspace, return an exactly sized copy
+	return vector<Vector4f>(points.begin(), points.end());
 }
-void savePoints(const std::vector<bool> &arr, const Eigen::Vector4f &rSource,
+void savePoints(const OccupancyGrid &arr, const Eigen::Vector4f &rSource,
 		const float &discretizationStep, const std::string &fileName)
 {
 	using Eigen::Vector3f;
 	using std::vector;
-	const int edgeL = std::lround(std::cbrt(arr.size()));
+	const int edgeL = arr.edgeL();
 	const int center = edgeL2center(edgeL);
 
 	std::ofstream of(fileName);
 	of << "999999\n \n";
-	int vertex = 0;
 	for (int x = 0; x < edgeL; ++x) {
 		for (int y = 0; y < edgeL; ++y) {
 			for (int z = 0; z < edgeL; ++z) {
-				if (arr[vertex] == true) {
+				if (arr.test(x, y, z)) {
 					Vector3f r(x - center, y - center,
 						   z - center);
 					r *= discretizationStep;
@@ -333,84 +1120,523 @@ void savePoints(const std::vector<bool> &arr, const Eigen::Vector4f &rSource,
 					of << "AV " << r[0] << " " << r[1]
 					   << " " << r[2] << "\n";
 				}
-				++vertex;
 			}
 		}
 	}
 }
 
-std::vector<Eigen::Vector4f>
-calculateAV(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
-	    float linkerLength, float linkerWidth, float dyeRadius,
-	    float discretizationStep, float contactR, float trappedFrac,
-	    const TabulatedFunction &weighting)
+void clipPathLength(const std::vector<float> &pathL, const int &maxR,
+		    std::vector<float> &clipped)
 {
-	using Eigen::Vector4f;
+	// path lengths of vertices further away from the source than maxR
+	// are set to infinity, same as blockOutside() would do for a shorter
+	// linker
+	const int maxRSq = maxR * maxR;
+	const int edgeL = std::lround(std::cbrt(pathL.size()));
+	const int center = edgeL2center(edgeL);
+	clipped = pathL;
+	int i = 0;
+	for (int x = 0; x < edgeL; ++x) {
+		for (int y = 0; y < edgeL; ++y) {
+			for (int z = 0; z < edgeL; ++z, ++i) {
+				int dSq = (x - center) * (x - center)
+					  + (y - center) * (y - center)
+					  + (z - center) * (z - center);
+				if (dSq > maxRSq) {
+					clipped[i] =
+						std::numeric_limits<float>::max();
+				}
+			}
+		}
+	}
+}
+
+std::vector<float> historyKey(const std::vector<float> &linkerLengths,
+			      float linkerWidth,
+			      const std::vector<float> &dyeRadii,
+			      float discretizationStep, float contactR,
+			      float trappedFrac, const AVOptions &options)
+{
+	// all parameters, which the stored AVs depend on, except the atoms
+	std::vector<float> key = {linkerWidth,
+				  discretizationStep,
+				  contactR,
+				  trappedFrac,
+				  float(options.pathEngine),
+				  float(options.stencil),
+				  float(options.occupancyBackend),
+				  float(options.coarseFactor),
+				  float(dyeRadii.size())};
+	key.insert(key.end(), dyeRadii.begin(), dyeRadii.end());
+	key.insert(key.end(), linkerLengths.begin(), linkerLengths.end());
+	return key;
+}
+
+bool historyMatches(const AVHistory *history, const std::vector<float> &key)
+{
+	return history && history->valid && history->key == key;
+}
+
+bool atomsUnchanged(const AVHistory &history,
+		    const std::vector<Eigen::Vector4f> &xyzR,
+		    const Eigen::Vector4f &rSource)
+{
+	// atoms are compared relative to the source, so that a rigid
+	// translation of the whole neighbourhood does not count as a change
+	if (history.xyzR.size() != xyzR.size()) {
+		return false;
+	}
+	const float tolSq = history.tolerance * history.tolerance;
+	for (size_t i = 0; i < xyzR.size(); ++i) {
+		const Eigen::Vector4f &old = history.xyzR[i];
+		if (xyzR[i][3] != old[3]) {
+			return false;
+		}
+		const Eigen::Vector3f d =
+			xyzR[i].head<3>() - rSource.head<3>() - old.head<3>();
+		if (d.squaredNorm() > tolSq) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::vector<Eigen::Vector4f>>
+translatedAVs(const AVHistory &history, const Eigen::Vector4f &rSource)
+{
+	const Eigen::Vector3f shift =
+		rSource.head<3>() - history.rSource.head<3>();
+	std::vector<std::vector<Eigen::Vector4f>> avs = history.avs;
+	for (auto &av : avs) {
+		for (Eigen::Vector4f &r : av) {
+			r.head<3>() += shift;
+		}
+	}
+	return avs;
+}
+
+void storeHistory(AVHistory *history, std::vector<float> &&key,
+		  const std::vector<Eigen::Vector4f> &xyzR,
+		  const Eigen::Vector4f &rSource, const AVWorkspace &workspace,
+		  const std::vector<std::vector<Eigen::Vector4f>> &avs)
+{
+	if (!history) {
+		return;
+	}
+	history->key = std::move(key);
+	history->rSource = rSource;
+	history->xyzR.resize(xyzR.size());
+	for (size_t i = 0; i < xyzR.size(); ++i) {
+		history->xyzR[i] = xyzR[i];
+		history->xyzR[i].head<3>() -= rSource.head<3>();
+	}
+	history->linker = workspace.linker;
+	history->pathL = workspace.pathL;
+	history->avs = avs;
+	history->valid = true;
+}
+
+void coarseToFinePathLength(const int factor, const float linkerLength,
+			    const float discretizationStep,
+			    const AVOptions &options, AVWorkspace &workspace)
+{
+	// Approximate path lengths on the fine grid (workspace.linker), with
+	// the fine search only near obstacles and near the end of the linker.
+	// The path lengths are first computed on a grid with factor times
+	// larger step, a coarse cell is free only if all of its fine voxels
+	// are, so that coarse paths do not pass through gaps closed on the fine
+	// grid. In the "interior" coarse cells (reachable neighbourhood, at
+	// least one coarse step from the end of the linker) fine path lengths
+	// are interpolated from the coarse ones. The fine search then runs
+	// from the source and from the rim of the interior over the rest of
+	// the grid only. Where it finds a rim vertex shorter than interpolated,
+	// the interior behind it is searched again.
 	using std::vector;
-	const float maxR = std::max(linkerWidth * 0.5f, dyeRadius);
-	auto occupancyVdWL =
-		xyzr2occupancy(xyzR, rSource, linkerLength + maxR,
-			       discretizationStep, linkerWidth * 0.5f);
+	const float inf = std::numeric_limits<float>::max();
+	const OccupancyGrid &fine = workspace.linker;
+	const int edgeL = fine.edgeL(), center = edgeL2center(edgeL);
+	const int edgeLC = 2 * ((center + factor - 1) / factor + 1) + 1;
+	const int centerC = edgeL2center(edgeLC);
+	// nearest coarse vertex of each fine coordinate and the coarse
+	// vertex/weight pair for interpolation
+	thread_local vector<int> parent, lower, cellWidth;
+	thread_local vector<float> frac;
+	parent.resize(edgeL);
+	lower.resize(edgeL);
+	frac.resize(edgeL);
+	cellWidth.assign(edgeLC, 0);
+	for (int i = 0; i < edgeL; ++i) {
+		const int d = i - center + factor / 2;
+		const int c = centerC
+			      + (d >= 0 ? d / factor
+					: -((factor - 1 - d) / factor));
+		parent[i] = std::min(std::max(c, 0), edgeLC - 1);
+		++cellWidth[parent[i]];
+		const float u = float(i - center) / factor + centerC;
+		lower[i] = std::floor(u);
+		frac[i] = u - lower[i];
+	}
+
+	// the cells, which are cut by the edge of the fine grid, or contain an
+	// obstacle, are blocked
+	OccupancyGrid &coarse = workspace.coarseLinker;
+	coarse.reset(edgeLC);
+	for (int x = 0; x < edgeLC; ++x) {
+		for (int y = 0; y < edgeLC; ++y) {
+			if (cellWidth[x] < factor || cellWidth[y] < factor) {
+				coarse.fillRow(x, y);
+				continue;
+			}
+			for (int z = 0; z < edgeLC; ++z) {
+				if (cellWidth[z] < factor) {
+					coarse.set(x, y, z);
+				}
+			}
+		}
+	}
+	for (int x = 0; x < edgeL; ++x) {
+		for (int y = 0; y < edgeL; ++y) {
+			const long rowBit = fine.bit(x, y, 0);
+			for (int z = 0; z < edgeL; ++z) {
+				if (fine.test(rowBit + z)) {
+					coarse.set(parent[x], parent[y],
+						   parent[z]);
+				}
+			}
+		}
+	}
+	const vector<float> &coarsePathL = workspace.coarsePathL;
+	pathLength(coarse, options, workspace.coarsePathL);
+
+	const float maxFineL = linkerLength / discretizationStep;
+	vector<char> &trusted = workspace.trusted;
+	trusted.resize(coarsePathL.size());
+	for (size_t c = 0; c < coarsePathL.size(); ++c) {
+		trusted[c] = coarsePathL[c] < inf
+			     && !coarse.test(coarse.bitFromIndex(c))
+			     && (coarsePathL[c] + 1.0f) * factor < maxFineL;
+	}
+	// interpolation needs all the neighbours of the cell to be reachable
+	vector<char> &interior = workspace.interior;
+	interior.assign(coarsePathL.size(), 0);
+	for (int x = 1; x < edgeLC - 1; ++x) {
+		for (int y = 1; y < edgeLC - 1; ++y) {
+			for (int z = 1; z < edgeLC - 1; ++z) {
+				const int c = index(x, y, z, edgeLC);
+				bool all = trusted[c];
+				for (int dx = -1; dx <= 1 && all; ++dx) {
+					for (int dy = -1; dy <= 1 && all;
+					     ++dy) {
+						const int row =
+							c
+							+ index(dx, dy, 0,
+								edgeLC);
+						all = coarsePathL[row - 1] < inf
+						      && coarsePathL[row] < inf
+						      && coarsePathL[row + 1]
+								 < inf;
+					}
+				}
+				interior[c] = all;
+			}
+		}
+	}
+
+	auto interpolate = [&](int x, int y, int z) {
+		// trilinear interpolation of the coarse path lengths, in fine
+		// grid units
+		const float *p = &coarsePathL[index(lower[x], lower[y],
+						    lower[z], edgeLC)];
+		const int dx = edgeLC * edgeLC, dy = edgeLC;
+		const float tx = frac[x], ty = frac[y], tz = frac[z];
+		auto lerp = [](float a, float b, float t) {
+			return t > 0.0f ? a + (b - a) * t : a;
+		};
+		const float l00 = lerp(p[0], p[1], tz);
+		const float l01 = lerp(p[dy], p[dy + 1], tz);
+		const float l10 = lerp(p[dx], p[dx + 1], tz);
+		const float l11 = lerp(p[dx + dy], p[dx + dy + 1], tz);
+		return lerp(lerp(l00, l01, ty), lerp(l10, l11, ty), tx)
+		       * factor;
+	};
+	// Interior vertices next to the rest of the grid are the seeds of the
+	// fine search, the rest of the interior is excluded from it. Longer
+	// edges can not jump into the interior, so the fine search has to pass
+	// through the seeds.
+	auto isRim = [&](int x, int y, int z) {
+		const int c = index(parent[x], parent[y], parent[z], edgeLC);
+		return !interior[index(parent[x - 1], parent[y], parent[z],
+				       edgeLC)]
+		       || !interior[index(parent[x + 1], parent[y], parent[z],
+					  edgeLC)]
+		       || !interior[index(parent[x], parent[y - 1], parent[z],
+					  edgeLC)]
+		       || !interior[index(parent[x], parent[y + 1], parent[z],
+					  edgeLC)]
+		       || !interior[c - 1] || !interior[c + 1];
+	};
+
+	OccupancyGrid &search = workspace.search;
+	search = fine;
+	vector<float> &pathL = workspace.pathL;
+	pathL.assign(fine.size(), inf);
+	thread_local vector<int> seeds;
+	thread_local vector<float> seedL;
+	seeds.clear();
+	seedL.clear();
+	int vertex = 0;
+	for (int x = 0; x < edgeL; ++x) {
+		for (int y = 0; y < edgeL; ++y) {
+			const int c0 = index(parent[x], parent[y], 0, edgeLC);
+			for (int z = 0; z < edgeL; ++z, ++vertex) {
+				if (!interior[c0 + parent[z]]) {
+					continue;
+				}
+				pathL[vertex] = interpolate(x, y, z);
+				if (isRim(x, y, z)) {
+					seeds.push_back(vertex);
+					seedL.push_back(pathL[vertex]);
+				} else {
+					search.set(x, y, z);
+				}
+			}
+		}
+	}
+	const int sourceVertex = index(center, center, center, edgeL);
+	pathL[sourceVertex] = 0.0f;
+	seeds.push_back(sourceVertex);
+	dijkstra(search, options, pathL, seeds);
+
+	// The fine search lowers the rim vertices, which are reached faster
+	// around the obstacles, than the coarse grid can tell. The interior
+	// behind them is then too long, so it is searched from them again.
+	// Shortcuts of less than a fine step are left to the interpolation.
+	const float tolerance = 1.0f;
+	thread_local vector<int> repairs;
+	repairs.clear();
+	for (size_t i = 0; i + 1 < seeds.size(); ++i) {
+		if (pathL[seeds[i]] < seedL[i] - tolerance) {
+			repairs.push_back(seeds[i]);
+		}
+	}
+	dijkstra(fine, options, pathL, repairs);
+}
+
+int coarseFactor(const AVOptions &options, const float linkerWidth,
+		 const float discretizationStep)
+{
+	// A coarse step longer than the linker radius blocks nearly every
+	// cell next to an atom, the coarse search then covers little of the
+	// grid. Such factors are reduced to the largest one that fits.
+	const int maxFactor =
+		std::max(1, int(linkerWidth * 0.5f / discretizationStep));
+	if (options.coarseFactor <= maxFactor) {
+		return options.coarseFactor;
+	}
+	static std::once_flag warned;
+	std::call_once(warned, [&] {
+		std::cerr << "coarse_grid_factor " << options.coarseFactor
+			  << " is too large for the grid resolution, using "
+			  << maxFactor << "\n"
+			  << std::flush;
+	});
+	return maxFactor;
+}
+
+void linkerPathLength(const ClashMaps &clashMaps, const float linkerWidth,
+		      const float linkerLength, const float discretizationStep,
+		      const AVOptions &options, AVWorkspace &workspace,
+		      const AVHistory *history)
+{
+	// history: previous calculation with the same parameters or nullptr
+	OccupancyGrid &occupancyVdWL = workspace.linker;
+	clashMaps.occupancy(occupancyVdWL, linkerWidth * 0.5f);
 	int linkerR = std::lround(linkerWidth * 0.5f / discretizationStep);
 	ignoreSphere(occupancyVdWL, linkerR + 1);
+	blockOutside(occupancyVdWL, linkerLength / discretizationStep,
+		     options.parallelVoxels);
+	const int factor =
+		coarseFactor(options, linkerWidth, discretizationStep);
+	// The update relies on exact path lengths, the coarse-to-fine ones
+	// are partly interpolated, so that search is repeated as a whole.
+	if (history && factor <= 1
+	    && history->linker.edgeL() == occupancyVdWL.edgeL()) {
+		workspace.pathL = history->pathL;
+		updatePathLength(history->linker, occupancyVdWL, options,
+				 workspace.pathL);
+		return;
+	}
+	if (factor > 1) {
+		coarseToFinePathLength(factor, linkerLength, discretizationStep,
+				       options, workspace);
+		return;
+	}
+	pathLength(occupancyVdWL, options, workspace.pathL);
+}
 
-	std::string fname = "occVdWL_" + std::to_string(rSource[0]) + "_"
-			    + std::to_string(rSource[1])
-			    + std::to_string(rSource[2]) + ".xyz";
-	// savePoints(occupancyVdWL,rSource,discretizationStep,fname);
+std::vector<std::vector<Eigen::Vector4f>>
+calculateAVSweep(const std::vector<Eigen::Vector4f> &xyzR,
+		 Eigen::Vector4f rSource,
+		 const std::vector<float> &linkerLengths, float linkerWidth,
+		 float dyeRadius, float discretizationStep, float contactR,
+		 float trappedFrac,
+		 const std::vector<TabulatedFunction> &weightings,
+		 const AVOptions &options, AVHistory *history)
+{
+	using Eigen::Vector4f;
+	using std::vector;
+	if (linkerLengths.empty()) {
+		return {};
+	}
+	if (weightings.size() != linkerLengths.size()) {
+		std::cerr << "calculateAVSweep: number of weighting functions "
+			     "does not match the number of linker lengths\n"
+			  << std::flush;
+		return {};
+	}
+	std::vector<float> key =
+		historyKey(linkerLengths, linkerWidth, {dyeRadius},
+			   discretizationStep, contactR, trappedFrac, options);
+	const bool matches = historyMatches(history, key);
+	if (matches && atomsUnchanged(*history, xyzR, rSource)) {
+		return translatedAVs(*history, rSource);
+	}
+	const float maxLinkerLength =
+		*std::max_element(linkerLengths.begin(), linkerLengths.end());
+	const float maxR = std::max(linkerWidth * 0.5f, dyeRadius);
+	AVWorkspace &workspace = avWorkspace();
+	const ClashMaps clashMaps(xyzR, rSource, maxLinkerLength + maxR,
+				  discretizationStep, maxR, options,
+				  workspace);
+	// a single path length search for the longest linker, shorter ones
+	// only need the vertices outside of their sphere to be cut off
+	linkerPathLength(clashMaps, linkerWidth, maxLinkerLength,
+			 discretizationStep, options, workspace,
+			 matches ? history : nullptr);
+	const vector<float> &pathL = workspace.pathL;
+	const int maxBlockR = maxLinkerLength / discretizationStep;
+	OccupancyGrid &occupancyVdWDye = workspace.dye[0];
+	clashMaps.occupancy(occupancyVdWDye, dyeRadius);
 
-	blockOutside(occupancyVdWL, linkerLength / discretizationStep);
-	const auto &pathL = pathLength(occupancyVdWL);
-	auto occupancyVdWDye =
-		xyzr2occupancy(xyzR, rSource, linkerLength + maxR,
-			       discretizationStep, dyeRadius);
-	auto ret = path2points(pathL, occupancyVdWDye, rSource, linkerLength,
-			       discretizationStep, contactR, trappedFrac,
-			       weighting);
-	return std::move(ret);
+	vector<vector<Vector4f>> avs;
+	avs.reserve(linkerLengths.size());
+	for (size_t i = 0; i < linkerLengths.size(); ++i) {
+		const int blockR = linkerLengths[i] / discretizationStep;
+		const bool clip = blockR < maxBlockR;
+		if (clip) {
+			clipPathLength(pathL, blockR, workspace.clippedPathL);
+		}
+		const vector<float> &curPathL =
+			clip ? workspace.clippedPathL : pathL;
+		avs.push_back(path2points(curPathL, occupancyVdWDye, rSource,
+					  linkerLengths[i], discretizationStep,
+					  contactR, trappedFrac, weightings[i],
+					  options.parallelVoxels));
+	}
+	storeHistory(history, std::move(key), xyzR, rSource, workspace, avs);
+	return avs;
 }
 
-std::vector<Eigen::Vector4f>
-calculateAV3(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
-	     float linkerLength, float linkerWidth, Eigen::Vector3f dyeRadii,
-	     float discretizationStep, float contactR, float trappedFrac)
+std::vector<std::vector<Eigen::Vector4f>>
+calculateAV3Sweep(const std::vector<Eigen::Vector4f> &xyzR,
+		  Eigen::Vector4f rSource,
+		  const std::vector<float> &linkerLengths, float linkerWidth,
+		  Eigen::Vector3f dyeRadii, float discretizationStep,
+		  float contactR, float trappedFrac, const AVOptions &options,
+		  AVHistory *history)
 {
 	using Eigen::Vector4f;
 	using std::vector;
+	if (linkerLengths.empty()) {
+		return {};
+	}
+	std::vector<float> key = historyKey(
+		linkerLengths, linkerWidth,
+		{dyeRadii[0], dyeRadii[1], dyeRadii[2]}, discretizationStep,
+		contactR, trappedFrac, options);
+	const bool matches = historyMatches(history, key);
+	if (matches && atomsUnchanged(*history, xyzR, rSource)) {
+		return translatedAVs(*history, rSource);
+	}
+	const float maxLinkerLength =
+		*std::max_element(linkerLengths.begin(), linkerLengths.end());
 	const float maxR = std::max(linkerWidth * 0.5f, dyeRadii.maxCoeff());
-	auto occupancyVdWL =
-		xyzr2occupancy(xyzR, rSource, linkerLength + maxR,
-			       discretizationStep, linkerWidth * 0.5f);
-	int linkerR = std::lround(linkerWidth * 0.5f / discretizationStep);
-	ignoreSphere(occupancyVdWL, linkerR + 1);
-	blockOutside(occupancyVdWL, linkerLength / discretizationStep);
-	const auto &pathL = pathLength(occupancyVdWL);
-
-	TabulatedFunction f(0.0, linkerLength + 100.0,
-			    Eigen::VectorXd::Constant(2, 1.0));
-
-	std::vector<Eigen::Vector4f> points;
+	AVWorkspace &workspace = avWorkspace();
+	const ClashMaps clashMaps(xyzR, rSource, maxLinkerLength + maxR,
+				  discretizationStep, maxR, options,
+				  workspace);
+	linkerPathLength(clashMaps, linkerWidth, maxLinkerLength,
+			 discretizationStep, options, workspace,
+			 matches ? history : nullptr);
+	const vector<float> &pathL = workspace.pathL;
+	const int maxBlockR = maxLinkerLength / discretizationStep;
+	std::array<OccupancyGrid, 3> &occupancyVdWDye = workspace.dye;
 	for (int i = 0; i < 3; i++) {
-		float dyeR = dyeRadii[i];
-		auto occupancyVdWDye =
-			xyzr2occupancy(xyzR, rSource, linkerLength + maxR,
-				       discretizationStep, dyeR);
-		auto cur = path2points(pathL, occupancyVdWDye, rSource,
-				       linkerLength, discretizationStep,
-				       contactR, trappedFrac, f);
-		points.reserve(points.size() + cur.size());
-		std::move(cur.begin(), cur.end(), std::back_inserter(points));
+		clashMaps.occupancy(occupancyVdWDye[i], dyeRadii[i]);
 	}
-	return std::move(points);
+
+	vector<vector<Vector4f>> avs;
+	avs.reserve(linkerLengths.size());
+	for (const float linkerLength : linkerLengths) {
+		const int blockR = linkerLength / discretizationStep;
+		const bool clip = blockR < maxBlockR;
+		if (clip) {
+			clipPathLength(pathL, blockR, workspace.clippedPathL);
+		}
+		const vector<float> &curPathL =
+			clip ? workspace.clippedPathL : pathL;
+		TabulatedFunction f(0.0, linkerLength + 100.0,
+				    Eigen::VectorXd::Constant(2, 1.0));
+		vector<Vector4f> points;
+		for (int i = 0; i < 3; i++) {
+			auto cur = path2points(curPathL, occupancyVdWDye[i],
+					       rSource, linkerLength,
+					       discretizationStep, contactR,
+					       trappedFrac, f,
+					       options.parallelVoxels);
+			points.reserve(points.size() + cur.size());
+			std::move(cur.begin(), cur.end(),
+				  std::back_inserter(points));
+		}
+		avs.push_back(std::move(points));
+	}
+	storeHistory(history, std::move(key), xyzR, rSource, workspace, avs);
+	return avs;
 }
 
 std::vector<Eigen::Vector4f>
 calculateAV(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
 	    float linkerLength, float linkerWidth, float dyeRadius,
-	    float discretizationStep, float contactR, float trappedFrac)
+	    float discretizationStep, float contactR, float trappedFrac,
+	    const TabulatedFunction &weighting, const AVOptions &options)
+{
+	auto avs = calculateAVSweep(xyzR, rSource, {linkerLength}, linkerWidth,
+				    dyeRadius, discretizationStep, contactR,
+				    trappedFrac, {weighting}, options);
+	return std::move(avs[0]);
+}
+
+std::vector<Eigen::Vector4f>
+calculateAV3(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
+	     float linkerLength, float linkerWidth, Eigen::Vector3f dyeRadii,
+	     float discretizationStep, float contactR, float trappedFrac,
+	     const AVOptions &options)
+{
+	auto avs = calculateAV3Sweep(xyzR, rSource, {linkerLength},
+				     linkerWidth, dyeRadii, discretizationStep,
+				     contactR, trappedFrac, options);
+	return std::move(avs[0]);
+}
+
+std::vector<Eigen::Vector4f>
+calculateAV(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
+	    float linkerLength, float linkerWidth, float dyeRadius,
+	    float discretizationStep, float contactR, float trappedFrac,
+	    const AVOptions &options)
 {
 	TabulatedFunction f(0.0, linkerLength + 100.0,
 			    Eigen::VectorXd::Constant(2, 1.0));
 	return calculateAV(xyzR, rSource, linkerLength, linkerWidth, dyeRadius,
-			   discretizationStep, contactR, trappedFrac, f);
+			   discretizationStep, contactR, trappedFrac, f,
+			   options);
 }
@@ -2,8 +2,11 @@
 #define FRETAV_H
 #include <limits>
 #include <vector>
+#include <string>
 #include <Eigen/Dense>
 
+#include "OccupancyGrid.h"
+
 class TabulatedFunction
 {
 	double xMin = 0.0, xMax = 0.0;
@@ -32,19 +35,113 @@ public:
 	}
 };
 
+// Priority queue used by the linker path length (Dijkstra) search.
+// BucketQueue is a monotone bucket queue (Dial's algorithm) with the bucket
+// width equal to the shortest edge, it produces the same path lengths as
+// the BinaryHeap, but does not need to keep the queue sorted.
+enum class PathLengthEngine { BinaryHeap, BucketQueue };
+PathLengthEngine pathLengthEngine(const std::string &name);
+std::string pathLengthEngineName(const PathLengthEngine &engine);
+
+// How the clash grids of the linker and of the dye are obtained.
+// Raster stamps a sphere of radius vdW+probe for every atom and every probe.
+// DistanceTransform computes the clearance of every voxel to the v.d.Waals
+// surface in one pass over the atoms and thresholds it at each probe radius.
+// The clearance is rounded like the raster spheres, so both backends give the
+// same clash grids.
+enum class OccupancyBackend { Raster, DistanceTransform };
+OccupancyBackend occupancyBackend(const std::string &name);
+std::string occupancyBackendName(const OccupancyBackend &backend);
+
+// Neighbours, which are connected by an edge in the linker path length
+// search. NeighboursN connects each voxel to N neighbours: 6 faces, 18 also
+// edges, 26 also corners, 50 and 74 also the (2,1,0) and (2,1,1) knight
+// moves. Smaller stencils are faster, but the isopath surfaces become less
+// spherical (cubic for 6 neighbours) and the path lengths longer.
+enum class PathStencil {
+	Neighbours6,
+	Neighbours18,
+	Neighbours26,
+	Neighbours50,
+	Neighbours74
+};
+PathStencil pathStencil(const std::string &name);
+std::string pathStencilName(const PathStencil &stencil);
+
+struct AVOptions {
+	PathLengthEngine pathEngine = PathLengthEngine::BucketQueue;
+	PathStencil stencil = PathStencil::Neighbours74;
+	OccupancyBackend occupancyBackend = OccupancyBackend::Raster;
+	// Coarse-to-fine path length search: values >1 first search a grid
+	// with coarseFactor times larger step and run the fine search only
+	// near obstacles and near the end of the linker. Path lengths far from
+	// both are interpolated from the coarse grid. 1 is a plain fine search.
+	// The factor is limited to linkerWidth/2 over the step. The AVs are
+	// within about 0.5% of the fine volume and 0.05 A of its mean position.
+	int coarseFactor = 1;
+	// Grids with at least this many voxels are rasterized, searched and
+	// converted to points by several threads (slabs along x, parallel
+	// delta-stepping for the path lengths), with the same results as the
+	// sequential code. 0 disables it.
+	long parallelVoxels = 8l << 20;
+};
+
+// State of the previous AV calculation of the same labeling position, e.g.
+// in the previous frame of a trajectory. Filled and used by
+// calculateAVSweep()/calculateAV3Sweep(), only the tolerance is meant to be
+// set by the caller. If no atom moved (relative to the source) by more than
+// tolerance [A], the previous AVs are translated to the new source.
+// Otherwise only the part of the linker path length grid, which can be
+// affected by the changed voxels, is searched again (the whole grid with
+// AVOptions::coarseFactor>1). The previous AVs are reused as is, so the
+// weighting functions must not change between calls.
+struct AVHistory {
+	float tolerance = 0.0f;
+	bool valid = false;
+	std::vector<float> key; // parameters of the calculation
+	Eigen::Vector4f rSource;
+	std::vector<Eigen::Vector4f> xyzR; // relative to rSource
+	OccupancyGrid linker;
+	std::vector<float> pathL;
+	std::vector<std::vector<Eigen::Vector4f>> avs;
+};
+
 std::vector<Eigen::Vector4f>
 calculateAV(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
 	    float linkerLength, float linkerWidth, float dyeRadius,
 	    float discretizationStep, float contactR, float trappedFrac,
-	    const TabulatedFunction &weighting);
+	    const TabulatedFunction &weighting,
+	    const AVOptions &options = AVOptions());
 
 std::vector<Eigen::Vector4f>
 calculateAV(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
 	    float linkerLength, float linkerWidth, float dyeRadius,
-	    float discretizationStep, float contactR, float trappedFrac);
+	    float discretizationStep, float contactR, float trappedFrac,
+	    const AVOptions &options = AVOptions());
 
 std::vector<Eigen::Vector4f>
 calculateAV3(const std::vector<Eigen::Vector4f> &xyzR, Eigen::Vector4f rSource,
 	     float linkerLength, float linkerWidth, Eigen::Vector3f dyeRadii,
-	     float discretizationStep, float contactR, float trappedFrac);
+	     float discretizationStep, float contactR, float trappedFrac,
+	     const AVOptions &options = AVOptions());
+// Same as above for several linker lengths at once. The path lengths are
+// only computed once, for the longest linker. Returns one AV per length.
+std::vector<std::vector<Eigen::Vector4f>>
+calculateAVSweep(const std::vector<Eigen::Vector4f> &xyzR,
+		 Eigen::Vector4f rSource,
+		 const std::vector<float> &linkerLengths, float linkerWidth,
+		 float dyeRadius, float discretizationStep, float contactR,
+		 float trappedFrac,
+		 const std::vector<TabulatedFunction> &weightings,
+		 const AVOptions &options = AVOptions(),
+		 AVHistory *history = nullptr);
+
+std::vector<std::vector<Eigen::Vector4f>>
+calculateAV3Sweep(const std::vector<Eigen::Vector4f> &xyzR,
+		  Eigen::Vector4f rSource,
+		  const std::vector<float> &linkerLengths, float linkerWidth,
+		  Eigen::Vector3f dyeRadii, float discretizationStep,
+		  float contactR, float trappedFrac,
+		  const AVOptions &options = AVOptions(),
+		  AVHistory *history = nullptr);
 #endif // FRETAV_H
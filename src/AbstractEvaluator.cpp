@@ -15,8 +15,38 @@ AbstractEvaluator::Task AbstractEvaluator::getTask(const FrameDescriptor &desc,
 	}
 }
 
-AbstractEvaluator::PterosSysTask
-AbstractEvaluator::getSysTask(const FrameDescriptor &frame) const
+AbstractEvaluator::FrameTask
+AbstractEvaluator::getFrameTask(const FrameDescriptor &frame) const
 {
-	return _storage.getSysTask(frame);
+	return _storage.getFrameTask(frame);
+}
+
+AbstractEvaluator::PairTask
+AbstractEvaluator::getPairTask(const FrameDescriptor &frame, const EvalId &av1,
+			       const EvalId &av2,
+			       const std::vector<double> &R0s) const
+{
+	try {
+		return _storage.getPairTask(frame, av1, av2, R0s);
+	} catch (...) {
+		std::cerr << "ERROR! Could not create a pair task (exception): "
+				     + frame.fullName()
+			  << std::flush;
+		return PairTask();
+	}
+}
+
+std::uint64_t
+AbstractEvaluator::samplingSeed(const FrameDescriptor &frame) const
+{
+	return stringSeed(frame.fullName() + '\n' + name());
+}
+
+std::uint64_t AbstractEvaluator::stringSeed(const std::string &str)
+{
+	std::uint64_t seed = 0xcbf29ce484222325ull;
+	for (const char c : str) {
+		seed = (seed ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+	}
+	return seed;
 }
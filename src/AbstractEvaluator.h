@@ -2,6 +2,7 @@
 #define ABSTRACTEVALUATOR_H
 #include "AbstractCalcResult.h"
 #include "FrameDescriptor.h"
+#include "FrameData.h"
 #include "TaskStorage.h"
 
 #include <pteros/pteros.h>
@@ -37,7 +38,8 @@ public:
 	}
 
 	using Task = async::shared_task<std::shared_ptr<AbstractCalcResult>>;
-	using PterosSysTask = async::shared_task<pteros::System>;
+	using FrameTask = async::shared_task<FrameData>;
+	using PairTask = TaskStorage::PairTask;
 	using Setting = std::pair<QString, QVariant>;
 	// pure virtual:
 	virtual Task makeTask(const FrameDescriptor &frame) const noexcept = 0;
@@ -51,10 +53,31 @@ public:
 	virtual std::string name() const = 0;
 	virtual void setName(const std::string &name) = 0;
 
+	struct PairRadius {
+		EvalId av1, av2;
+		double R0;
+	};
+	// Pairs of AVs (in any order) and Forster radii, for which the
+	// evaluator reads <E> from the shared pair statistics, see
+	// TaskStorage::getPairTask()
+	virtual std::vector<PairRadius> forsterRadii() const
+	{
+		return {};
+	}
+	// FNV-1a hash of str, std::hash is not the same on all platforms
+	static std::uint64_t stringSeed(const std::string &str);
+
 
 protected:
 	Task getTask(const FrameDescriptor &desc, const EvalId &evId,
 		     bool persistent) const;
-	PterosSysTask getSysTask(const FrameDescriptor &frame) const;
+	FrameTask getFrameTask(const FrameDescriptor &frame) const;
+	PairTask getPairTask(const FrameDescriptor &frame, const EvalId &av1,
+			     const EvalId &av2,
+			     const std::vector<double> &R0s) const;
+	// Seed for the Monte-Carlo estimates of this evaluator in the frame.
+	// Depends only on the names, so that the results are reproducible
+	// regardless of the order, in which the frames are evaluated.
+	std::uint64_t samplingSeed(const FrameDescriptor &frame) const;
 };
 #endif // ABSTRACTEVALUATOR_H
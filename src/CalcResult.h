@@ -41,6 +41,27 @@ public:
 		return _value;
 	}
 };
+// Value with the bound of its error in the second column. It is still a
+// CalcResult<double> for the evaluators, which use the value.
+class BoundedCalcResult : public CalcResult<double>
+{
+private:
+	double _bound;
+
+public:
+	BoundedCalcResult(double val, double bound)
+	    : CalcResult<double>(val), _bound(bound)
+	{
+	}
+	std::string toString(int i) const
+	{
+		return std::to_string(i == 0 ? get() : _bound);
+	}
+	unsigned int columnsCount() const
+	{
+		return 2;
+	}
+};
 template <>
 inline std::string CalcResult<Eigen::Vector3d>::toString(int i) const
 {
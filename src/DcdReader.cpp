@@ -0,0 +1,134 @@
+#include "DcdReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+std::int32_t swapped(std::int32_t value)
+{
+	std::uint32_t u;
+	std::memcpy(&u, &value, 4);
+	u = (u >> 24) | ((u >> 8) & 0xff00u) | ((u << 8) & 0xff0000u)
+	    | (u << 24);
+	std::memcpy(&value, &u, 4);
+	return value;
+}
+} // namespace
+
+std::int32_t DcdReader::toInt(const char *bytes) const
+{
+	std::int32_t value;
+	std::memcpy(&value, bytes, 4);
+	return _swap ? swapped(value) : value;
+}
+
+float DcdReader::toFloat(const char *bytes) const
+{
+	const std::int32_t i = toInt(bytes);
+	float value;
+	std::memcpy(&value, &i, 4);
+	return value;
+}
+
+DcdReader::DcdReader(const std::string &fileName)
+    : _fileName(fileName), _file(fileName, std::ios::binary)
+{
+	auto fail = [&fileName](const std::string &what) {
+		std::cerr << "ERROR! Can not read DCD " + fileName + ": " + what
+				     + "\n"
+			  << std::flush;
+	};
+	// Fortran records: 4 byte length, data, 4 byte length.
+	// 1st record: "CORD" and 20 control integers
+	char head[92];
+	if (!_file.read(head, sizeof(head))) {
+		fail("file is too short");
+		return;
+	}
+	_swap = toInt(head) != 84;
+	if (toInt(head) != 84 || toInt(head + 88) != 84
+	    || std::memcmp(head + 4, "CORD", 4) != 0) {
+		fail("unknown header");
+		return;
+	}
+	const char *icntrl = head + 8;
+	const bool charmm = toInt(icntrl + 4 * 19) != 0;
+	const int numFixed = toInt(icntrl + 4 * 8);
+	if (numFixed > 0) {
+		fail("fixed atoms are not supported");
+		return;
+	}
+	const bool hasCell = charmm && toInt(icntrl + 4 * 10) != 0;
+	const bool has4D = charmm && toInt(icntrl + 4 * 11) != 0;
+
+	// 2nd record: titles, 3rd record: number of atoms
+	char marker[4];
+	if (!_file.read(marker, 4)) {
+		fail("file is too short");
+		return;
+	}
+	const std::int64_t titleSize = toInt(marker);
+	_file.seekg(titleSize + 4, std::ios::cur);
+	char natoms[12];
+	if (titleSize < 0 || !_file.read(natoms, sizeof(natoms))
+	    || toInt(natoms) != 4 || toInt(natoms + 8) != 4) {
+		fail("unknown header");
+		return;
+	}
+	const int numAtoms = toInt(natoms + 4);
+	if (numAtoms <= 0) {
+		fail("no atoms");
+		return;
+	}
+	_headerSize = 92 + 4 + titleSize + 4 + 12;
+
+	// per frame: unit cell (6 doubles), X, Y, Z (and W) records
+	const std::int64_t coordSize = 4 * std::int64_t(numAtoms) + 8;
+	_cellSize = hasCell ? 48 + 8 : 0;
+	_frameSize = _cellSize + (has4D ? 4 : 3) * coordSize;
+	_file.seekg(0, std::ios::end);
+	const std::int64_t fileSize = _file.tellg();
+	_numFrames = std::max<std::int64_t>(0, fileSize - _headerSize)
+		     / _frameSize;
+	_numAtoms = numAtoms;
+}
+
+bool DcdReader::read(int frame, std::vector<Eigen::Vector3f> &xyz)
+{
+	if (!valid() || frame < 0 || frame >= _numFrames) {
+		return false;
+	}
+	const std::int64_t coordSize = 4 * std::int64_t(_numAtoms) + 8;
+	_buffer.resize(3 * coordSize);
+	_file.clear();
+	_file.seekg(_headerSize + frame * _frameSize + _cellSize);
+	if (!_file.read(_buffer.data(), _buffer.size())) {
+		std::cerr << "ERROR! Can not read frame "
+				     + std::to_string(frame) + " of "
+				     + _fileName + "\n"
+			  << std::flush;
+		return false;
+	}
+	const char *x = _buffer.data() + 4;
+	const char *y = x + coordSize;
+	const char *z = y + coordSize;
+	const std::int32_t recordSize = 4 * _numAtoms;
+	for (const char *record : {x, y, z}) {
+		if (toInt(record - 4) != recordSize
+		    || toInt(record + recordSize) != recordSize) {
+			std::cerr << "ERROR! Frame " + std::to_string(frame)
+					     + " of " + _fileName
+					     + " is corrupted\n"
+				  << std::flush;
+			return false;
+		}
+	}
+	xyz.resize(_numAtoms);
+	for (int i = 0; i < _numAtoms; ++i) {
+		xyz[i] = Eigen::Vector3f(toFloat(x + 4 * i), toFloat(y + 4 * i),
+					 toFloat(z + 4 * i));
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef DCDREADER_H
+#define DCDREADER_H
+
+#include <Eigen/Dense>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Random access to the frames of a CHARMM/NAMD DCD trajectory. Only the
+// header is read on construction; all frames have the same size, so the
+// byte offset of any frame is known from the header and a frame is read
+// with a single seek on demand. Trajectories with fixed atoms (NAMNF>0),
+// whose frames differ in size, are not supported.
+// Not thread safe, the file stream is shared by all reads.
+class DcdReader
+{
+public:
+	explicit DcdReader(const std::string &fileName);
+	// false if the file could not be opened or the header is not supported
+	bool valid() const
+	{
+		return _numAtoms > 0;
+	}
+	int numAtoms() const
+	{
+		return _numAtoms;
+	}
+	// complete frames in the file (NSET in the header is not always
+	// updated, when a simulation is appended or interrupted)
+	int numFrames() const
+	{
+		return _numFrames;
+	}
+	// coordinates of the frame (in Angstroms), false on failure
+	bool read(int frame, std::vector<Eigen::Vector3f> &xyz);
+
+private:
+	std::int32_t toInt(const char *bytes) const;
+	float toFloat(const char *bytes) const;
+
+	std::string _fileName;
+	std::ifstream _file;
+	bool _swap = false;
+	int _numAtoms = 0;
+	int _numFrames = 0;
+	std::int64_t _headerSize = 0;
+	std::int64_t _frameSize = 0;
+	// size of the unit cell record in front of the coordinates
+	std::int64_t _cellSize = 0;
+	std::vector<char> _buffer;
+};
+
+#endif // DCDREADER_H
@@ -42,7 +42,7 @@ EvaluatorAvFile::makeTask(const FrameDescriptor &frame) const noexcept
 			auto resAv = dynamic_cast<
 				CalcResult<PositionSimulationResult> *>(
 				ptrAv.get());
-			PositionSimulationResult av = resAv->get();
+			const PositionSimulationResult &av = resAv->get();
 			QFileInfo trajInfo(QString::fromStdString(trajFname));
 			QFileInfo _writeDirInfo(
 				QString::fromStdString(_writeDirPath));
@@ -79,18 +79,28 @@ EvaluatorAvFile::makeTask(const FrameDescriptor &frame) const noexcept
 		.share();
 }
 
+bool EvaluatorAvFile::dump(const PositionSimulationResult &av,
+			   const std::string &fname) const
+{
+	if (_onlyShell) {
+		return av.dumpShellXyz(fname + ".xyz");
+	} else if (_openDX) {
+		return av.dump_dxmap(fname + ".dx");
+	}
+	return av.dumpPqr(fname + ".pqr");
+}
+
 std::shared_ptr<AbstractCalcResult>
 EvaluatorAvFile::calculate(const PositionSimulationResult &av,
 			   const std::string &fname) const
 {
 	// std::cout<<"Dumping: "+fname+"\n"<<std::flush;
-	bool isSaved = false;
-	if (_onlyShell) {
-		isSaved = av.dumpShellXyz(fname + ".xyz");
-	} else if (_openDX) {
-		isSaved = av.dump_dxmap(fname + ".dx");
-	} else {
-		isSaved = av.dumpPqr(fname + ".pqr");
+	bool isSaved = dump(av, fname);
+	// AVs for other linker lengths get the length appended to the name
+	for (const auto &lengthAv : av.sweep()) {
+		const std::string suffix =
+			"_L" + QString::number(lengthAv.first).toStdString();
+		isSaved &= dump(lengthAv.second, fname + suffix);
 	}
 	return std::make_shared<CalcResult<bool>>(isSaved);
 }
@@ -94,6 +94,8 @@ private:
 	virtual std::shared_ptr<AbstractCalcResult>
 	calculate(const PositionSimulationResult &av,
 		  const std::string &fname) const;
+	bool dump(const PositionSimulationResult &av,
+		  const std::string &fname) const;
 };
 
 #endif // EVALUATORAVFILE_H
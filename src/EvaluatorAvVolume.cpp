@@ -12,7 +12,7 @@ EvaluatorAvVolume::makeTask(const FrameDescriptor &frame) const noexcept
 			auto resAv = dynamic_cast<
 				CalcResult<PositionSimulationResult> *>(
 				ptrAv.get());
-			PositionSimulationResult av = resAv->get();
+			const PositionSimulationResult &av = resAv->get();
 			return calculate(av);
 		})
 		.share();
@@ -29,9 +29,37 @@ EvaluatorDistance::makeTask(const FrameDescriptor &frame) const noexcept
 			       std::shared_ptr<AbstractCalcResult>(res))
 			.share();
 	}
+	if (sharesPairStatistics()) {
+		const bool isRdae = _dist.type() == "RDAMeanE";
+		const double R0 = _dist.R0();
+		PairTask pair = getPairTask(frame, _av1, _av2,
+					    isRdae ? std::vector<double>{R0}
+						   : std::vector<double>());
+		auto nan = std::numeric_limits<double>::quiet_NaN();
+		if (!pair.valid()) {
+			auto res = std::make_shared<CalcResult<double>>(nan);
+			return async::make_task(
+				       std::shared_ptr<AbstractCalcResult>(res))
+				.share();
+		}
+		return pair
+			.then([isRdae, R0, nan](PairTask task) {
+				const auto stats = task.get();
+				double dist = nan;
+				if (stats) {
+					dist = isRdae ? stats->Rdae(R0)
+						      : stats->Rda;
+				}
+				std::shared_ptr<AbstractCalcResult> r;
+				r = std::make_shared<CalcResult<double>>(dist);
+				return r;
+			})
+			.share();
+	}
+	const std::uint64_t seed = samplingSeed(frame);
 	using result_t = std::tuple<Task, Task>;
 	return async::when_all(av1, av2)
-		.then([this](result_t result) {
+		.then([this, seed](result_t result) {
 			const Task &av1task = std::get<0>(result);
 			auto ptrAv1 = av1task.get();
 			auto ptrAv2 = std::get<1>(result).get();
@@ -47,17 +75,33 @@ EvaluatorDistance::makeTask(const FrameDescriptor &frame) const noexcept
 						double>::quiet_NaN());
 				return std::shared_ptr<AbstractCalcResult>(res);
 			}
-			PositionSimulationResult av1 = resAv1->get();
-			PositionSimulationResult av2 = resAv2->get();
-			return calculate(av1, av2);
+			const PositionSimulationResult &av1 = resAv1->get();
+			const PositionSimulationResult &av2 = resAv2->get();
+			return calculate(av1, av2, seed);
 		})
 		.share();
 }
 
+std::vector<AbstractEvaluator::PairRadius>
+EvaluatorDistance::forsterRadii() const
+{
+	if (sharesPairStatistics() && _dist.type() == "RDAMeanE") {
+		return {{_av1, _av2, _dist.R0()}};
+	}
+	return {};
+}
+
 std::shared_ptr<AbstractCalcResult>
 EvaluatorDistance::calculate(const PositionSimulationResult &av1,
-			     const PositionSimulationResult &av2) const
+			     const PositionSimulationResult &av2,
+			     std::uint64_t seed) const
 {
-	double result = _dist.modelDistance(av1, av2);
+	if (_compressionTolerance > 0.0) {
+		const BoundedValue result = _dist.approxModelDistance(
+			av1, av2, _compressionTolerance);
+		return std::make_shared<BoundedCalcResult>(result.value,
+							   result.bound);
+	}
+	double result = _dist.modelDistance(av1, av2, seed, _samplingTolerance);
 	return std::make_shared<CalcResult<double>>(result);
 }
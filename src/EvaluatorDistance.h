@@ -15,6 +15,12 @@ class EvaluatorDistance : public AbstractEvaluator
 private:
 	EvalId _av1 = _storage.evaluatorPositionSimulation, _av2 = _av1;
 	Distance _dist;
+	// standard error [A], at which the sampling of the model distance
+	// stops, 0 - fixed number of samples
+	double _samplingTolerance = 0.0;
+	// error bound [A] of the model distance from the compressed AVs, with
+	// the bound in the second column, 0 - the full AVs
+	double _compressionTolerance = 0.0;
 
 public:
 	EvaluatorDistance(const TaskStorage &storage, const EvalId &av1,
@@ -41,17 +47,17 @@ public:
 	{
 		return "Distances";
 	}
-	virtual std::string columnName(int) const
+	virtual std::string columnName(int i) const
 	{
-		return name();
+		return i == 0 ? name() : name() + " bound";
 	}
 	virtual int columnCount() const
 	{
-		return 1;
+		return _compressionTolerance > 0.0 ? 2 : 1;
 	}
 	virtual int settingsCount() const
 	{
-		return 7;
+		return 9;
 	}
 	virtual Setting setting(int row) const override
 	{
@@ -81,6 +87,10 @@ public:
 			return {"error_pos", _dist.errPos()};
 		case 6:
 			return {"Forster_radius", _dist.R0()};
+		case 7:
+			return {"sampling_tolerance", _samplingTolerance};
+		case 8:
+			return {"compression_tolerance", _compressionTolerance};
 		}
 		return {"", ""};
 	}
@@ -131,6 +141,12 @@ public:
 		case 6:
 			_dist.setR0(val.toDouble());
 			return;
+		case 7:
+			_samplingTolerance = val.toDouble();
+			return;
+		case 8:
+			_compressionTolerance = val.toDouble();
+			return;
 		}
 	}
 	virtual void setName(const std::string &name)
@@ -141,11 +157,21 @@ public:
 	{
 		return _dist;
 	}
+	virtual std::vector<PairRadius> forsterRadii() const;
 
 private:
+	// Without the tolerances <Rda> and <Rda>E are read from the pair
+	// statistics, Rmp is cheaper to compute directly.
+	bool sharesPairStatistics() const
+	{
+		return _samplingTolerance == 0.0 && _compressionTolerance == 0.0
+		       && (_dist.type() == "RDAMean"
+			   || _dist.type() == "RDAMeanE");
+	}
 	virtual std::shared_ptr<AbstractCalcResult>
 	calculate(const PositionSimulationResult &av1,
-		  const PositionSimulationResult &av2) const;
+		  const PositionSimulationResult &av2,
+		  std::uint64_t seed) const;
 };
 
 #endif // EVALUATORDISTANCE_H
@@ -80,10 +80,11 @@ EvaluatorDistanceDistribution::makeTask(const FrameDescriptor &frame) const
 	// std::string posName1 = _storage.eval(_av1).name();
 	// std::string posName2 = _storage.eval(_av2).name();
 	std::string trajFname = frame.trajFileName();
+	const std::uint64_t seed = samplingSeed(frame);
 
 	using result_t = std::tuple<Task, Task>;
 	return async::when_all(av1, av2)
-		.then([this, trajFname](result_t result) {
+		.then([this, trajFname, seed](result_t result) {
 			auto ptrAv1 = std::get<0>(result).get();
 			auto ptrAv2 = std::get<1>(result).get();
 			auto resAv1 = dynamic_cast<
@@ -98,9 +99,9 @@ EvaluatorDistanceDistribution::makeTask(const FrameDescriptor &frame) const
 						double>::quiet_NaN());
 				return std::shared_ptr<AbstractCalcResult>(res);
 			}
-			PositionSimulationResult av1 = resAv1->get();
-			PositionSimulationResult av2 = resAv2->get();
-			return calculate(av1, av2, trajFname);
+			const PositionSimulationResult &av1 = resAv1->get();
+			const PositionSimulationResult &av2 = resAv2->get();
+			return calculate(av1, av2, trajFname, seed);
 		})
 		.share();
 }
@@ -108,7 +109,8 @@ EvaluatorDistanceDistribution::makeTask(const FrameDescriptor &frame) const
 std::shared_ptr<AbstractCalcResult>
 EvaluatorDistanceDistribution::calculate(const PositionSimulationResult &av1,
 					 const PositionSimulationResult &av2,
-					 const std::string traj) const
+					 const std::string traj,
+					 std::uint64_t seed) const
 {
 	std::ostringstream buf;
 	buf << std::setprecision(4);
@@ -116,7 +118,7 @@ EvaluatorDistanceDistribution::calculate(const PositionSimulationResult &av1,
 	buf << traj;
 	unsigned numBins = lround((_distMax - _distMin) / _binSize);
 	std::vector<double> hist =
-		av1.RdaDist(av2, _distMin, _distMax, numBins);
+		av1.RdaDist(av2, _distMin, _distMax, numBins, 2000000, seed);
 	for (double freq : hist) {
 		buf << '\t' << freq;
 	}
@@ -116,7 +116,7 @@ private:
 	virtual std::shared_ptr<AbstractCalcResult>
 	calculate(const PositionSimulationResult &av1,
 		  const PositionSimulationResult &av2,
-		  const std::string traj) const;
+		  const std::string traj, std::uint64_t seed) const;
 };
 
 #endif // DISTANCEDISTRIBUTION_H
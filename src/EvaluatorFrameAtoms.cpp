@@ -0,0 +1,40 @@
+#include "EvaluatorFrameAtoms.h"
+// before CalcResult.h, which uses std::to_string(const AtomCellList &)
+#include "AV/AtomCellList.h"
+#include "CalcResult.h"
+#include "AV/Position.h"
+
+std::shared_ptr<const std::vector<float>>
+EvaluatorFrameAtoms::radii(const std::string &topology,
+			   const pteros::System &system) const
+{
+	{
+		std::lock_guard<std::mutex> lock(_radiiMtx);
+		auto it = _radii.find(topology);
+		if (it != _radii.end()
+		    && it->second->size() == size_t(system.num_atoms())) {
+			return it->second;
+		}
+	}
+	auto radii = std::make_shared<const std::vector<float>>(
+		vdWRadii(system));
+	std::lock_guard<std::mutex> lock(_radiiMtx);
+	_radii[topology] = radii;
+	return radii;
+}
+
+AbstractEvaluator::Task
+EvaluatorFrameAtoms::makeTask(const FrameDescriptor &frame) const noexcept
+{
+	auto frameTask = getFrameTask(frame);
+	return frameTask
+		.then([this, frame](const FrameData &data) {
+			auto r = radii(frame.topologyFileName(),
+				       data.topology());
+			AtomCellList atoms(coordsVdW(data.coords(), *r));
+			return std::shared_ptr<AbstractCalcResult>(
+				std::make_shared<CalcResult<AtomCellList>>(
+					std::move(atoms)));
+		})
+		.share();
+}
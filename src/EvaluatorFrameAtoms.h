@@ -0,0 +1,65 @@
+#ifndef EVALUATORFRAMEATOMS_H
+#define EVALUATORFRAMEATOMS_H
+
+#include "AbstractEvaluator.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Hidden helper evaluator. Collects the coordinates and v.d.Waals radii of
+// all atoms of a frame into a cell list (CalcResult<AtomCellList>), which is
+// then shared by all position simulations of this frame. The radii only
+// depend on the topology and are computed once per topology file.
+class EvaluatorFrameAtoms : public AbstractEvaluator
+{
+public:
+	EvaluatorFrameAtoms(const TaskStorage &storage, const std::string &)
+	    : AbstractEvaluator(storage)
+	{
+	}
+	virtual Task makeTask(const FrameDescriptor &frame) const noexcept;
+	virtual std::string name() const
+	{
+		return "frame atoms";
+	}
+	virtual void setName(const std::string &)
+	{
+	}
+	virtual std::string className() const
+	{
+		return "Frame Atoms";
+	}
+	virtual std::string columnName(int) const
+	{
+		return name();
+	}
+	virtual int columnCount() const
+	{
+		return 0;
+	}
+	virtual int settingsCount() const
+	{
+		return 0;
+	}
+	virtual Setting setting(int) const
+	{
+		return {"", ""};
+	}
+	virtual void setSetting(int, const QVariant &)
+	{
+	}
+
+private:
+	std::shared_ptr<const std::vector<float>>
+	radii(const std::string &topology, const pteros::System &system) const;
+
+	mutable std::mutex _radiiMtx;
+	mutable std::unordered_map<std::string,
+				   std::shared_ptr<const std::vector<float>>>
+		_radii;
+};
+
+#endif // EVALUATORFRAMEATOMS_H
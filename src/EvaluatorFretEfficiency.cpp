@@ -10,11 +10,33 @@ EvaluatorFretEfficiency::EvaluatorFretEfficiency(const TaskStorage &storage,
 AbstractEvaluator::Task
 EvaluatorFretEfficiency::makeTask(const FrameDescriptor &frame) const noexcept
 {
+	if (sharesPairStatistics()) {
+		PairTask pair = getPairTask(frame, _av1, _av2, {_R0});
+		const double R0 = _R0;
+		auto nan = std::numeric_limits<double>::quiet_NaN();
+		if (!pair.valid()) {
+			auto res = std::make_shared<CalcResult<double>>(nan);
+			return async::make_task(
+				       std::shared_ptr<AbstractCalcResult>(res))
+				.share();
+		}
+		return pair
+			.then([R0, nan](PairTask task) {
+				const auto stats = task.get();
+				const double eff =
+					stats ? stats->meanEfficiency(R0) : nan;
+				std::shared_ptr<AbstractCalcResult> r;
+				r = std::make_shared<CalcResult<double>>(eff);
+				return r;
+			})
+			.share();
+	}
 	Task av1 = getTask(frame, _av1, false);
 	Task av2 = getTask(frame, _av2, false);
+	const std::uint64_t seed = samplingSeed(frame);
 	using result_t = std::tuple<Task, Task>;
 	return async::when_all(av1, av2)
-		.then([this](result_t result) {
+		.then([this, seed](result_t result) {
 			auto ptrAv1 = std::get<0>(result).get();
 			auto ptrAv2 = std::get<1>(result).get();
 			if (!ptrAv1 || !ptrAv2) {
@@ -30,17 +52,33 @@ EvaluatorFretEfficiency::makeTask(const FrameDescriptor &frame) const noexcept
 			auto resAv2 = dynamic_cast<
 				CalcResult<PositionSimulationResult> *>(
 				ptrAv2.get());
-			PositionSimulationResult av1 = resAv1->get();
-			PositionSimulationResult av2 = resAv2->get();
-			return calculate(av1, av2);
+			const PositionSimulationResult &av1 = resAv1->get();
+			const PositionSimulationResult &av2 = resAv2->get();
+			return calculate(av1, av2, seed);
 		})
 		.share();
 }
 
 std::shared_ptr<AbstractCalcResult>
 EvaluatorFretEfficiency::calculate(const PositionSimulationResult &av1,
-				   const PositionSimulationResult &av2) const
+				   const PositionSimulationResult &av2,
+				   std::uint64_t seed) const
 {
-	double eff = av1.meanFretEfficiency(av2, _R0);
+	if (_compressionTolerance > 0.0) {
+		const BoundedValue eff = av1.approxFretEfficiency(
+			av2, _R0, _compressionTolerance);
+		return std::make_shared<BoundedCalcResult>(eff.value,
+							   eff.bound);
+	}
+	double eff = av1.meanFretEfficiency(av2, _R0, seed, _samplingTolerance);
 	return std::make_shared<CalcResult<double>>(eff);
 }
+
+std::vector<AbstractEvaluator::PairRadius>
+EvaluatorFretEfficiency::forsterRadii() const
+{
+	if (sharesPairStatistics()) {
+		return {{_av1, _av2, _R0}};
+	}
+	return {};
+}
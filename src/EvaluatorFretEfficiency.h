@@ -9,6 +9,11 @@ class EvaluatorFretEfficiency : public AbstractEvaluator
 private:
 	EvalId _av1, _av2;
 	double _R0 = 52.0;
+	// standard error, at which the sampling of <E> stops, 0 - fixed count
+	double _samplingTolerance = 0.0;
+	// error bound of <E> from the compressed AVs, with the bound in the
+	// second column, 0 - the full AVs
+	double _compressionTolerance = 0.0;
 	std::string _name;
 
 public:
@@ -23,17 +28,17 @@ public:
 	{
 		return "Mean FRET Efficiencies";
 	}
-	virtual std::string columnName(int) const
+	virtual std::string columnName(int i) const
 	{
-		return name();
+		return i == 0 ? name() : name() + " bound";
 	}
 	virtual int columnCount() const
 	{
-		return 1;
+		return _compressionTolerance > 0.0 ? 2 : 1;
 	}
 	virtual int settingsCount() const
 	{
-		return 3;
+		return 5;
 	}
 	virtual Setting setting(int row) const override
 	{
@@ -54,6 +59,10 @@ public:
 		}
 		case 2:
 			return {"Forster_radius", _R0};
+		case 3:
+			return {"sampling_tolerance", _samplingTolerance};
+		case 4:
+			return {"compression_tolerance", _compressionTolerance};
 		}
 		return {"", ""};
 	}
@@ -90,17 +99,31 @@ public:
 		case 2:
 			_R0 = val.toDouble();
 			return;
+		case 3:
+			_samplingTolerance = val.toDouble();
+			return;
+		case 4:
+			_compressionTolerance = val.toDouble();
+			return;
 		}
 	}
 	virtual void setName(const std::string &name)
 	{
 		_name = name;
 	}
+	virtual std::vector<PairRadius> forsterRadii() const;
 
 private:
+	// without the tolerances <E> is read from the pair statistics
+	bool sharesPairStatistics() const
+	{
+		return _samplingTolerance == 0.0
+		       && _compressionTolerance == 0.0;
+	}
 	virtual std::shared_ptr<AbstractCalcResult>
 	calculate(const PositionSimulationResult &av1,
-		  const PositionSimulationResult &av2) const;
+		  const PositionSimulationResult &av2,
+		  std::uint64_t seed) const;
 };
 
 #endif // EVALUATORFRETEFFICIENCY_H
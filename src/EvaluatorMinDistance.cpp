@@ -24,8 +24,8 @@ EvaluatorMinDistance::makeTask(const FrameDescriptor &frame) const noexcept
 			auto resAv2 = dynamic_cast<
 				CalcResult<PositionSimulationResult> *>(
 				ptrAv2.get());
-			PositionSimulationResult av1 = resAv1->get();
-			PositionSimulationResult av2 = resAv2->get();
+			const PositionSimulationResult &av1 = resAv1->get();
+			const PositionSimulationResult &av2 = resAv2->get();
 			return calculate(av1, av2);
 		})
 		.share();
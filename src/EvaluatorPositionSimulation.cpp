@@ -2,10 +2,15 @@
 #include "CalcResult.h"
 
 std::shared_ptr<AbstractCalcResult>
-EvaluatorPositionSimulation::calculate(const pteros::System &system,
+EvaluatorPositionSimulation::calculate(const FrameData &data,
+				       const AtomCellList *atoms,
 				       const FrameDescriptor &frame) const
 {
-	PositionSimulationResult res = _position.calculate(system);
+	const std::string trajectory =
+		frame.topologyFileName() + "," + frame.trajFileName();
+	PositionSimulationResult res =
+		atoms ? _position.calculate(data, *atoms, trajectory)
+		      : _position.calculate(data, trajectory);
 	if (res.empty()) {
 		std::cout << "Empty AV: " + _position.name() + ", "
 				     + frame.fullName() + "\n";
@@ -22,10 +27,25 @@ EvaluatorPositionSimulation::calculate(const pteros::System &system,
 AbstractEvaluator::Task EvaluatorPositionSimulation::makeTask(
 	const FrameDescriptor &frame) const noexcept
 {
-	auto sysTask = getSysTask(frame);
-	return sysTask
-		.then([this, frame](pteros::System system) {
-			return calculate(system, frame);
+	auto frameTask = getFrameTask(frame);
+	Task atomsTask = getTask(frame, _storage.evaluatorFrameAtoms, false);
+	if (!atomsTask.valid()) {
+		return frameTask
+			.then([this, frame](const FrameData &data) {
+				return calculate(data, nullptr, frame);
+			})
+			.share();
+	}
+	using result_t = std::tuple<FrameTask, Task>;
+	return async::when_all(frameTask, atomsTask)
+		.then([this, frame](result_t result) {
+			const FrameData &data = std::get<0>(result).get();
+			auto ptrAtoms = std::get<1>(result).get();
+			auto resAtoms = dynamic_cast<CalcResult<AtomCellList> *>(
+				ptrAtoms.get());
+			const AtomCellList *atoms =
+				resAtoms ? &resAtoms->get() : nullptr;
+			return calculate(data, atoms, frame);
 		})
 		.share();
 }
@@ -10,7 +10,7 @@ class EvaluatorPositionSimulation : public AbstractEvaluator
 private:
 	Position _position;
 	std::shared_ptr<AbstractCalcResult>
-	calculate(const pteros::System &system,
+	calculate(const FrameData &data, const AtomCellList *atoms,
 		  const FrameDescriptor &frame) const;
 
 public:
@@ -5,37 +5,49 @@
 AbstractEvaluator::Task
 EvaluatorSphereAVOverlap::makeTask(const FrameDescriptor &frame) const noexcept
 {
-	PterosSysTask sysTask = getSysTask(frame);
+	FrameTask frameTask = getFrameTask(frame);
 	Task av = getTask(frame, _av1, false);
-	using result_t = std::tuple<PterosSysTask, Task>;
-	return async::when_all(sysTask, av)
-		.then([this](result_t result) {
+	// the cell list answers the "within" clauses of the selection
+	Task atoms;
+	if (SelectionCache::coordinateDependent(_selectionString)) {
+		atoms = getTask(frame, _storage.evaluatorFrameAtoms, false);
+	}
+	if (!atoms.valid()) {
+		atoms = async::make_task(std::shared_ptr<AbstractCalcResult>())
+				.share();
+	}
+	using result_t = std::tuple<FrameTask, Task, Task>;
+	return async::when_all(frameTask, av, atoms)
+		.then([this, frame](result_t result) {
 			auto ptrAv = std::get<1>(result).get();
 			auto resAv = dynamic_cast<
 				CalcResult<PositionSimulationResult> *>(
 				ptrAv.get());
-			PositionSimulationResult av = resAv->get();
-			pteros::System system = std::get<0>(result).get();
-			return calculate(system, av);
+			const PositionSimulationResult &av = resAv->get();
+			const FrameData &data = std::get<0>(result).get();
+			auto ptrAtoms = std::get<2>(result).get();
+			auto resAtoms = dynamic_cast<CalcResult<AtomCellList> *>(
+				ptrAtoms.get());
+			const AtomCellList *atoms =
+				resAtoms ? &resAtoms->get() : nullptr;
+			return calculate(data, av, atoms,
+					 frame.topologyFileName());
 		})
 		.share();
 }
 
 std::shared_ptr<AbstractCalcResult>
-EvaluatorSphereAVOverlap::calculate(const pteros::System &system,
-				    const PositionSimulationResult &av) const
+EvaluatorSphereAVOverlap::calculate(const FrameData &data,
+				    const PositionSimulationResult &av,
+				    const AtomCellList *atoms,
+				    const std::string &topology) const
 {
-	pteros::Selection select;
-	try {
-		select.modify(system, _selectionString);
-	} catch (const pteros::Pteros_error &err) {
-		std::cerr << err.what() << std::endl;
-	}
-
-	int selectedCount = select.size();
+	const SelectionCache::Indices selected =
+		_selections.indices(topology, data, _selectionString, atoms);
 	std::vector<Eigen::Vector3f> refs;
-	for (int i = 0; i < selectedCount; ++i) {
-		refs.push_back(select.xyz(i) * 10.0f);
+	refs.reserve(selected->size());
+	for (int i : *selected) {
+		refs.push_back(data.coords()[i] * 10.0f);
 	}
 
 	return std::make_shared<CalcResult<float>>(
@@ -2,6 +2,7 @@
 #define EVALUATORSPHEREAVOVERLAP_H
 
 #include "AbstractEvaluator.h"
+#include "AV/SelectionCache.h"
 
 class PositionSimulationResult;
 
@@ -12,6 +13,7 @@ private:
 	std::string _name;
 	std::string _selectionString;
 	float _overlapRadius = 0.0f;
+	mutable SelectionCache _selections;
 
 public:
 	EvaluatorSphereAVOverlap(const TaskStorage &storage,
@@ -79,8 +81,8 @@ public:
 
 private:
 	virtual std::shared_ptr<AbstractCalcResult>
-	calculate(const pteros::System &system,
-		  const PositionSimulationResult &av) const;
+	calculate(const FrameData &data, const PositionSimulationResult &av,
+		  const AtomCellList *atoms, const std::string &topology) const;
 };
 
 #endif // EVALUATORSPHEREAVOVERLAP_H
@@ -19,10 +19,10 @@ AbstractEvaluator::Task
 EvaluatorTrasformationMatrix::makeTask(const FrameDescriptor &frame) const
 	noexcept
 {
-	auto sysTask = getSysTask(frame);
-	return sysTask
-		.then([this](pteros::System system) {
-			return calculate(system);
+	auto frameTask = getFrameTask(frame);
+	return frameTask
+		.then([this, frame](const FrameData &data) {
+			return calculate(data, frame.topologyFileName());
 		})
 		.share();
 }
@@ -76,7 +76,8 @@ void EvaluatorTrasformationMatrix::setSetting(int row, const QVariant &val)
 }
 
 std::shared_ptr<AbstractCalcResult>
-EvaluatorTrasformationMatrix::calculate(const pteros::System &system) const
+EvaluatorTrasformationMatrix::calculate(const FrameData &data,
+					const std::string &topology) const
 {
 	// auto system=getSystem(desc);
 	Eigen::Matrix4d matrix;
@@ -85,14 +86,10 @@ EvaluatorTrasformationMatrix::calculate(const pteros::System &system) const
 	Eigen::Matrix<double, 3, Dynamic> positionGlobalCS(3, numPoints());
 	Eigen::Matrix<double, 3, Dynamic> positionLocalCS(3, numPoints());
 	for (int i = 0; i < numPoints(); i++) {
-		pteros::Selection select;
-		try {
-			select.modify(system, comSellPos[i].first);
-		} catch (const pteros::Pteros_error &err) {
-			std::cerr << err.what() << std::endl;
-		}
-
-		if (select.get_index().size() != 1) {
+		const SelectionCache::Indices selected =
+			_selections.indices(topology, data,
+					    comSellPos[i].first);
+		if (selected->size() != 1) {
 			std::cerr << std::endl;
 			std::cerr
 				<< "Specified selection could not be mapped correctly: "
@@ -103,7 +100,8 @@ EvaluatorTrasformationMatrix::calculate(const pteros::System &system) const
 				std::move(matrix));
 		}
 
-		positionGlobalCS.col(i) = select.xyz(0).cast<double>() * 10.0;
+		positionGlobalCS.col(i) =
+			data.coords()[selected->front()].cast<double>() * 10.0;
 		positionLocalCS.col(i) = comSellPos[i].second;
 	}
 	matrix = Eigen::umeyama(positionLocalCS, positionGlobalCS, false);
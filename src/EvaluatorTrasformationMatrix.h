@@ -3,6 +3,7 @@
 #include <QMetaType>
 #include "AbstractEvaluator.h"
 #include "TaskStorage.h"
+#include "AV/SelectionCache.h"
 #include <Eigen/Dense>
 
 class EvaluatorTrasformationMatrix : public AbstractEvaluator
@@ -11,6 +12,7 @@ private:
 	// MolecularSystemDomain _domain;
 	std::vector<std::pair<std::string, Eigen::Vector3d>> comSellPos;
 	std::string _name;
+	mutable SelectionCache _selections;
 	int numPoints() const
 	{
 		return comSellPos.size();
@@ -52,7 +54,7 @@ public:
 
 private:
 	std::shared_ptr<AbstractCalcResult>
-	calculate(const pteros::System &system) const;
+	calculate(const FrameData &data, const std::string &topology) const;
 };
 // Q_DECLARE_METATYPE( Eigen::Vector3d )
 #endif // EVALUATORTRANSORMATIONMATRIX_H
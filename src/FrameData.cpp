@@ -0,0 +1,64 @@
+#include "FrameData.h"
+
+FrameData::FrameData(std::shared_ptr<const pteros::System> topology,
+		     std::vector<Eigen::Vector3f> coords)
+    : _topology(std::move(topology)),
+      _coords(std::make_shared<const std::vector<Eigen::Vector3f>>(
+	      std::move(coords))),
+      _system(std::make_shared<Materialized>())
+{
+}
+
+FrameData::FrameData(pteros::System system)
+{
+	if (system.num_frames() == 0) {
+		system.frame_append(pteros::Frame());
+	}
+	_topology = std::make_shared<const pteros::System>(std::move(system));
+	// the coordinates are those of the topology, no copy needed
+	_coords = std::shared_ptr<const std::vector<Eigen::Vector3f>>(
+		_topology, &_topology->frame(0).coord);
+}
+
+FrameData FrameData::view(const pteros::System &system)
+{
+	// aliasing constructors without an owner, nothing is freed
+	FrameData frame;
+	frame._topology = std::shared_ptr<const pteros::System>(
+		std::shared_ptr<void>(), &system);
+	if (system.num_frames() > 0) {
+		frame._coords =
+			std::shared_ptr<const std::vector<Eigen::Vector3f>>(
+				std::shared_ptr<void>(),
+				&system.frame(0).coord);
+	}
+	return frame;
+}
+
+const pteros::System &FrameData::topology() const
+{
+	static const pteros::System empty;
+	return _topology ? *_topology : empty;
+}
+
+const std::vector<Eigen::Vector3f> &FrameData::coords() const
+{
+	static const std::vector<Eigen::Vector3f> empty;
+	return _coords ? *_coords : empty;
+}
+
+const pteros::System &FrameData::system() const
+{
+	if (!_system) {
+		return topology();
+	}
+	Materialized &m = *_system;
+	std::call_once(m.built, [this, &m] {
+		m.system = topology();
+		if (m.system.num_frames() == 0) {
+			m.system.frame_append(pteros::Frame());
+		}
+		m.system.frame(0).coord = coords();
+	});
+	return m.system;
+}
@@ -0,0 +1,58 @@
+#ifndef FRAMEDATA_H
+#define FRAMEDATA_H
+
+#include <Eigen/Dense>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pteros/pteros.h>
+
+// One frame of a trajectory: the topology (atom names, residues, chains,
+// ...), which is shared by all frames loaded with the same topology file,
+// and the coordinates of this frame. Copies share both, so that frames are
+// cheap to cache and to pass around.
+class FrameData
+{
+public:
+	FrameData() = default;
+	// coords in nm, as in pteros
+	FrameData(std::shared_ptr<const pteros::System> topology,
+		  std::vector<Eigen::Vector3f> coords);
+	// a frame with a topology of its own (e.g. a single PDB file)
+	explicit FrameData(pteros::System system);
+	// Frame of the system, which is not copied and must outlive the
+	// FrameData and its copies.
+	static FrameData view(const pteros::System &system);
+
+	bool empty() const
+	{
+		return numAtoms() == 0;
+	}
+	int numAtoms() const
+	{
+		return _coords ? _coords->size() : 0;
+	}
+	// The coordinates of the topology itself are those of the topology
+	// file, not of this frame. Selections, which depend on the
+	// coordinates, have to use coords() or system().
+	const pteros::System &topology() const;
+	// in nm
+	const std::vector<Eigen::Vector3f> &coords() const;
+	// The topology with the coordinates of this frame. It is built on the
+	// first call and shared by the copies of the frame.
+	const pteros::System &system() const;
+
+private:
+	struct Materialized {
+		std::once_flag built;
+		pteros::System system;
+	};
+	std::shared_ptr<const pteros::System> _topology;
+	std::shared_ptr<const std::vector<Eigen::Vector3f>> _coords;
+	// nullptr, if the topology has the coordinates of this frame
+	std::shared_ptr<Materialized> _system;
+};
+
+#endif // FRAMEDATA_H
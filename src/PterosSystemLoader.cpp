@@ -1,9 +1,47 @@
+#include <algorithm>
+#include <cctype>
 #include <set>
 #include <pteros/pteros.h>
 
 #include "PterosSystemLoader.h"
 #include "CalcResult.h"
 
+namespace
+{
+enum class TrajFormat { PDB, DCD, XTC, TRR };
+
+TrajFormat trajFormat(const std::string &trajPath)
+{
+	if (trajPath.length() < 4) {
+		return TrajFormat::PDB;
+	}
+	std::string sfx = trajPath.substr(trajPath.length() - 4);
+	std::transform(sfx.begin(), sfx.end(), sfx.begin(), ::tolower);
+	if (sfx == ".dcd") {
+		return TrajFormat::DCD;
+	}
+	if (sfx == ".xtc") {
+		return TrajFormat::XTC;
+	}
+	if (sfx == ".trr") {
+		return TrajFormat::TRR;
+	}
+	return TrajFormat::PDB;
+}
+
+// the shared topology with the coordinates of the frame, scaled to nm
+FrameData withCoords(const std::shared_ptr<const pteros::System> &top,
+		     std::vector<Eigen::Vector3f> xyz, float scale)
+{
+	if (scale != 1.0f) {
+		for (Eigen::Vector3f &r : xyz) {
+			r *= scale;
+		}
+	}
+	return FrameData(top, std::move(xyz));
+}
+} // namespace
+
 PterosSystemLoader::PterosSystemLoader()
 {
 }
@@ -12,9 +50,32 @@ PterosSystemLoader::~PterosSystemLoader()
 {
 }
 
-PterosSystemLoader::PterosSysTask
+PterosSystemLoader::FrameTask
 PterosSystemLoader::makeTask(const FrameDescriptor &frame)
 {
+	const TrajFormat format = trajFormat(frame.trajFileName());
+	if (format == TrajFormat::XTC || format == TrajFormat::TRR) {
+		// only reading the file is serialized, frames are decompressed
+		// in parallel on the default thread pool
+		return async::spawn(_threadpool,
+				    [frame, this] {
+					    try {
+						    return readXdr(frame);
+					    } catch (...) {
+						    return XdrFrame();
+					    }
+				    })
+			.then([frame](const XdrFrame &raw) {
+				FrameData data = fromXdr(raw);
+				if (data.empty()) {
+					std::cerr << "Could not load molecule: "
+							     + frame.fullName()
+							     + "\n";
+				}
+				return data;
+			})
+			.share();
+	}
 	return async::
 		spawn(_threadpool, [frame, this] {
 			try {
@@ -23,53 +84,126 @@ PterosSystemLoader::makeTask(const FrameDescriptor &frame)
 				std::cerr
 					<< "Could not load molecule (exception): "
 						   + frame.fullName() + "\n";
-				return pteros::System();
+				return FrameData();
 			}
 		}).share();
 }
 
-auto PterosSystemLoader::getDcd(const std::string &topPath,
-				const std::string &trajPath)
+DcdReader *PterosSystemLoader::getDcd(const std::string &topPath,
+				      const std::string &trajPath)
+{
+	const int numAtoms = getTopology(topPath)->num_atoms();
+	std::unique_ptr<DcdReader> &reader = _dcdCache[trajPath];
+	if (!reader) {
+		reader.reset(new DcdReader(trajPath));
+		if (reader->valid() && reader->numAtoms() != numAtoms) {
+			std::cerr << "ERROR! The number of atoms in " + topPath
+					     + " does not match " + trajPath
+					     + "\n"
+				  << std::flush;
+		}
+	}
+	if (!reader->valid() || reader->numAtoms() != numAtoms) {
+		return nullptr;
+	}
+	return reader.get();
+}
+
+XdrReader *PterosSystemLoader::getXdr(const std::string &topPath,
+				      const std::string &trajPath)
 {
-	auto it = _trajCache.find(trajPath);
-	if (it == _trajCache.end()) {
+	const int numAtoms = getTopology(topPath)->num_atoms();
+	std::unique_ptr<XdrReader> &reader = _xdrCache[trajPath];
+	if (!reader) {
+		const XdrReader::Format format =
+			trajFormat(trajPath) == TrajFormat::TRR
+				? XdrReader::Format::TRR
+				: XdrReader::Format::XTC;
+		reader.reset(new XdrReader(trajPath, format));
+		if (reader->valid() && reader->numAtoms() != numAtoms) {
+			std::cerr << "ERROR! The number of atoms in " + topPath
+					     + " does not match " + trajPath
+					     + "\n"
+				  << std::flush;
+		}
+	}
+	if (!reader->valid() || reader->numAtoms() != numAtoms) {
+		return nullptr;
+	}
+	return reader.get();
+}
+
+PterosSystemLoader::XdrFrame
+PterosSystemLoader::readXdr(const FrameDescriptor &frame)
+{
+	XdrReader *xdr = getXdr(frame.topologyFileName(), frame.trajFileName());
+	XdrFrame raw;
+	if (xdr && xdr->readRaw(frame.frame(), raw.second)) {
+		raw.first = getTopology(frame.topologyFileName());
+	}
+	return raw;
+}
+
+FrameData PterosSystemLoader::fromXdr(const XdrFrame &raw)
+{
+	std::vector<Eigen::Vector3f> xyz;
+	if (!raw.first || !XdrReader::decode(raw.second, xyz)) {
+		return FrameData();
+	}
+	// XTC and TRR are in nm, as pteros
+	return withCoords(raw.first, std::move(xyz), 1.0f);
+}
+
+const std::shared_ptr<const pteros::System> &
+PterosSystemLoader::getTopology(const std::string &topPath)
+{
+	auto it = _topCache.find(topPath);
+	if (it == _topCache.end()) {
+		pteros::System top;
 		try {
-			pteros::System sys(topPath);
-			sys.frame_delete();
-			sys.load(trajPath);
-			it = _trajCache.emplace(trajPath, std::move(sys)).first;
+			top = pteros::System(topPath);
 		} catch (...) {
-			it = _trajCache.emplace(trajPath, pteros::System())
-				     .first;
-			std::cerr << "ERROR! Can not load " + trajPath + "\n"
+			std::cerr << "ERROR! Can not load " + topPath + "\n"
 				  << std::flush;
+			top = pteros::System();
 		}
+		// exactly one frame to be filled from the trajectory,
+		// topologies without coordinates (e.g. psf) get an empty one
+		if (top.num_frames() > 1) {
+			top.frame_delete(1);
+		}
+		if (top.num_atoms() > 0 && top.num_frames() == 0) {
+			pteros::Frame frame;
+			frame.coord.resize(top.num_atoms());
+			top.frame_append(frame);
+		}
+		auto shared =
+			std::make_shared<const pteros::System>(std::move(top));
+		it = _topCache.emplace(topPath, std::move(shared)).first;
 	}
-	return it;
+	return it->second;
 }
 
-
-pteros::System PterosSystemLoader::load(const FrameDescriptor &frame)
+FrameData PterosSystemLoader::load(const FrameDescriptor &frame)
 {
 	const std::string &trajPath = frame.trajFileName();
-	const std::string &trajSfx = trajPath.substr(trajPath.length() - 4);
-	const std::unordered_set<std::string> trajExtensions = {".dcd", ".DCD"};
-	if (trajExtensions.count(trajSfx) > 0) {
-		auto dcdIt = getDcd(frame.topologyFileName(), trajPath);
-		pteros::Selection sel = dcdIt->second.select_all();
-		sel.set_frame(frame.frame());
-		pteros::System resSys;
-		resSys.append(sel, true);
-		assert(resSys.num_frames() == 1);
-		return resSys;
+	if (trajFormat(trajPath) == TrajFormat::DCD) {
+		DcdReader *dcd = getDcd(frame.topologyFileName(), trajPath);
+		std::vector<Eigen::Vector3f> xyz;
+		if (!dcd || !dcd->read(frame.frame(), xyz)) {
+			return FrameData();
+		}
+		// DCD is in Angstroms
+		return withCoords(getTopology(frame.topologyFileName()),
+				  std::move(xyz), 0.1f);
 	}
 	// PDB
 	try {
-		return pteros::System(frame.topologyFileName());
+		return FrameData(pteros::System(frame.topologyFileName()));
 	} catch (...) {
 		std::cerr << "ERROR! Can not load " + frame.fullName()
 			  << std::flush;
-		return pteros::System();
+		return FrameData();
 	}
 }
 async::task<int> PterosSystemLoader::numFrames(const std::string &topPath,
@@ -77,7 +211,13 @@ async::task<int> PterosSystemLoader::numFrames(const std::string &topPath,
 
 {
 	auto task = async::spawn(_threadpool, [&topPath, &trajPath, this] {
-		return getDcd(topPath, trajPath)->second.num_frames();
+		const TrajFormat format = trajFormat(trajPath);
+		if (format == TrajFormat::XTC || format == TrajFormat::TRR) {
+			const XdrReader *xdr = getXdr(topPath, trajPath);
+			return xdr ? xdr->numFrames() : 0;
+		}
+		const DcdReader *dcd = getDcd(topPath, trajPath);
+		return dcd ? dcd->numFrames() : 0;
 	});
 	return task;
 }
@@ -99,7 +239,7 @@ auto PterosSystemLoader::getTaskIterator(const FrameDescriptor &frame)
 		return pair.first;
 	}
 }
-PterosSystemLoader::PterosSysTask
+PterosSystemLoader::FrameTask
 PterosSystemLoader::getTask(const FrameDescriptor &frame)
 {
 	return async::spawn(_threadpool,
@@ -2,6 +2,9 @@
 #define PTEROSSYSTEMLOADER_H
 
 #include "FrameDescriptor.h"
+#include "FrameData.h"
+#include "DcdReader.h"
+#include "XdrReader.h"
 
 #include <async++.h>
 #include <pteros/pteros.h>
@@ -9,26 +12,45 @@
 class PterosSystemLoader
 {
 public:
-	using PterosSysTask = async::shared_task<pteros::System>;
+	using FrameTask = async::shared_task<FrameData>;
 	PterosSystemLoader();
 	~PterosSystemLoader();
 
 	async::task<int> numFrames(const std::string &topPath,
 				   const std::string &trajPath);
-	PterosSysTask getTask(const FrameDescriptor &frame);
+	FrameTask getTask(const FrameDescriptor &frame);
 	int taskCount() const;
 
 private:
 	mutable async::threadpool_scheduler _threadpool{
 		1}; // must be single thread
 
-	pteros::System load(const FrameDescriptor &frame);
-	auto getDcd(const std::string &topPath, const std::string &trajPath);
+	FrameData load(const FrameDescriptor &frame);
+	// nullptr if the trajectory can not be read or does not match the
+	// topology
+	DcdReader *getDcd(const std::string &topPath,
+			  const std::string &trajPath);
+	XdrReader *getXdr(const std::string &topPath,
+			  const std::string &trajPath);
+	// shared by all frames with this topology file
+	const std::shared_ptr<const pteros::System> &
+	getTopology(const std::string &topPath);
+	// topology and the still compressed frame, decompressed by
+	// fromXdr() outside of the loader thread
+	using XdrFrame = std::pair<std::shared_ptr<const pteros::System>,
+				   XdrReader::RawFrame>;
+	XdrFrame readXdr(const FrameDescriptor &frame);
+	static FrameData fromXdr(const XdrFrame &raw);
 	auto getTaskIterator(const FrameDescriptor &frame);
-	PterosSysTask makeTask(const FrameDescriptor &frame);
-
-	std::unordered_map<std::string, pteros::System> _trajCache;
-	std::unordered_map<FrameDescriptor, PterosSysTask> _sysCache;
+	FrameTask makeTask(const FrameDescriptor &frame);
+
+	// frames are read on demand, only the headers and the topologies are
+	// kept
+	std::unordered_map<std::string, std::unique_ptr<DcdReader>> _dcdCache;
+	std::unordered_map<std::string, std::unique_ptr<XdrReader>> _xdrCache;
+	std::unordered_map<std::string, std::shared_ptr<const pteros::System>>
+		_topCache;
+	std::unordered_map<FrameDescriptor, FrameTask> _sysCache;
 	const size_t _sysRingBufSize = 64;
 	std::vector<FrameDescriptor> _sysRingBuf{_sysRingBufSize};
 	size_t sysRingBufIndex = 0;
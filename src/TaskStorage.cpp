@@ -14,6 +14,7 @@
 #include "EvaluatorSphereAVOverlap.h"
 #include "EvaluatorAvFile.h"
 #include "EvaluatorAvVolume.h"
+#include "EvaluatorFrameAtoms.h"
 
 #include "AV/Position.h"
 #include "CalcResult.h"
@@ -31,7 +32,8 @@ const int TaskStorage::vec3dType =
 
 
 TaskStorage::TaskStorage()
-    : _tasksRingBuf(_tasksRingBufSize), _currentId(EvalId(0))
+    : _tasksRingBuf(_tasksRingBufSize), _pairTasksRingBuf(_tasksRingBufSize),
+      _currentId(EvalId(0))
 {
 	addEvaluator(std::make_unique<const EvaluatorPositionSimulation>(
 		*this, "unknown"));
@@ -71,6 +73,9 @@ TaskStorage::TaskStorage()
 	addEvaluator(std::make_unique<const EvaluatorDistanceDistribution>(
 		*this, "unknown"));
 	evaluatorEulerAngle = _currentId;
+	addEvaluator(
+		std::make_unique<const EvaluatorFrameAtoms>(*this, "unknown"));
+	evaluatorFrameAtoms = _currentId;
 
 	_maxStubEval = _currentId;
 	_runRequestsTask =
@@ -151,6 +156,78 @@ const TaskStorage::Task &TaskStorage::makeTask(const CacheKey &key,
 	return task;
 }
 
+// must only run in worker thread
+const TaskStorage::PairTask &
+TaskStorage::getPairTask(const FrameDescriptor &frame, EvalId av1, EvalId av2,
+			 const std::vector<double> &R0s) const
+{
+	static auto tid = std::this_thread::get_id();
+	assert(tid == std::this_thread::get_id());
+	if (av2 < av1) {
+		std::swap(av1, av2);
+	}
+	const PairKey key(CacheKey(frame, av1), av2);
+	auto it = _pairTasks.find(key);
+	if (it != _pairTasks.end()) {
+		const std::vector<double> &known = it->second.R0s;
+		auto isKnown = [&known](double R0) {
+			return std::find(known.begin(), known.end(), R0)
+			       != known.end();
+		};
+		if (std::all_of(R0s.begin(), R0s.end(), isKnown)) {
+			return it->second.task;
+		}
+	}
+
+	std::vector<double> allR0s = R0s;
+	const auto radii = _pairRadii.find({av1, av2});
+	if (radii != _pairRadii.end()) {
+		allR0s.insert(allR0s.end(), radii->second.begin(),
+			      radii->second.end());
+	}
+	std::sort(allR0s.begin(), allR0s.end());
+	allR0s.erase(std::unique(allR0s.begin(), allR0s.end()), allR0s.end());
+	// the same random pairs regardless of the evaluator, which came first
+	std::string seedName = frame.fullName();
+	for (const EvalId &id : {av1, av2}) {
+		seedName += '\n' + (isValid(id) ? evalName(id) : std::string());
+	}
+	const std::uint64_t seed = AbstractEvaluator::stringSeed(seedName);
+
+	Task task1 = getTask(frame, av1, false);
+	Task task2 = getTask(frame, av2, false);
+	using result_t = std::tuple<Task, Task>;
+	using StatsPtr = std::shared_ptr<const AVPairStatistics>;
+	PairTask task =
+		async::when_all(task1, task2)
+			.then([allR0s, seed](result_t result) {
+				auto ptr1 = std::get<0>(result).get();
+				auto ptr2 = std::get<1>(result).get();
+				auto res1 = dynamic_cast<
+					CalcResult<PositionSimulationResult> *>(
+					ptr1.get());
+				auto res2 = dynamic_cast<
+					CalcResult<PositionSimulationResult> *>(
+					ptr2.get());
+				if (!res1 || !res2) {
+					return StatsPtr();
+				}
+				return StatsPtr(
+					std::make_shared<AVPairStatistics>(
+						res1->get().pairStatistics(
+							res2->get(), allR0s,
+							seed)));
+			})
+			.share();
+	if (it == _pairTasks.end()) {
+		pushPairTask(key);
+	}
+	PairEntry &entry = _pairTasks[key];
+	entry.R0s = std::move(allR0s);
+	entry.task = std::move(task);
+	return entry.task;
+}
+
 void TaskStorage::runRequests() const
 {
 	static auto tid = std::this_thread::get_id();
@@ -440,10 +517,14 @@ EvalId TaskStorage::addEvaluator(EvalUPtr evptr)
 {
 	_evals.emplace(++_currentId, std::move(evptr));
 	_evalNames.emplace(eval(_currentId).name(), _currentId);
+	for (const auto &r : eval(_currentId).forsterRadii()) {
+		_pairRadii[std::minmax(r.av1, r.av2)].push_back(r.R0);
+	}
 	Q_EMIT evaluatorAdded(_currentId);
 	_tasksRingBufSize = std::max(_tasksRingBufSize, _evals.size() * 2);
 	if (_tasksRingBufSize > _tasksRingBuf.size()) {
 		_tasksRingBuf.resize(_tasksRingBufSize);
+		_pairTasksRingBuf.resize(_tasksRingBufSize);
 	}
 	return _currentId;
 }
@@ -452,6 +533,20 @@ void TaskStorage::removeEvaluator(const EvalId &evId)
 {
 	Q_EMIT evaluatorIsGoingToBeRemoved(evId);
 	_evalNames.erase(eval(evId).name());
+	for (const auto &r : eval(evId).forsterRadii()) {
+		const auto pair = _pairRadii.find(std::minmax(r.av1, r.av2));
+		if (pair == _pairRadii.end()) {
+			continue;
+		}
+		std::vector<double> &radii = pair->second;
+		const auto R0 = std::find(radii.begin(), radii.end(), r.R0);
+		if (R0 != radii.end()) {
+			radii.erase(R0);
+		}
+		if (radii.empty()) {
+			_pairRadii.erase(pair);
+		}
+	}
 	const auto it = _evals.find(evId);
 	_removedEvals.push_back(std::move(it->second));
 	_evals.erase(it);
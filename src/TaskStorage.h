@@ -2,12 +2,14 @@
 #define TASKSTORAGE_H
 #include "AbstractCalcResult.h"
 #include "FrameDescriptor.h"
+#include "FrameData.h"
 #include "PterosSystemLoader.h"
 
 #include <pteros/pteros.h>
 
 #include <async++.h>
 
+#include <map>
 #include <memory>
 #include <vector>
 #include <unordered_map>
@@ -31,6 +33,7 @@ template <typename K, typename V>
 using CuckooMap = cuckoohash_map<K, V, std::hash<K>>;
 class AbstractEvaluator;
 class EvaluatorPositionSimulation;
+struct AVPairStatistics;
 using EvalUPtr = std::unique_ptr<const AbstractEvaluator>;
 template <class Tag, class Base = int> struct def_enum {
 	enum class type : Base {};
@@ -46,6 +49,8 @@ inline EvalId operator++(EvalId &id)
 }
 
 using CacheKey = std::pair<FrameDescriptor, EvalId>;
+// frame and the first AV, second AV of a pair
+using PairKey = std::pair<CacheKey, EvalId>;
 namespace std
 {
 template <> struct hash<CacheKey> {
@@ -56,6 +61,14 @@ template <> struct hash<CacheKey> {
 		return seed;
 	}
 };
+template <> struct hash<PairKey> {
+	size_t operator()(const PairKey &k) const
+	{
+		size_t seed = hash<CacheKey>()(k.first);
+		hash_combine(seed, k.second);
+		return seed;
+	}
+};
 template <> struct hash<EvalId> {
 	size_t operator()(const EvalId &k) const
 	{
@@ -94,14 +107,16 @@ public:
 	using CacheKey = ::CacheKey;
 	using Result = std::shared_ptr<AbstractCalcResult>;
 	using Task = async::shared_task<Result>;
-	using PterosSysTask = async::shared_task<pteros::System>;
+	using FrameTask = async::shared_task<FrameData>;
+	using PairTask =
+		async::shared_task<std::shared_ptr<const AVPairStatistics>>;
 	std::string getString(const FrameDescriptor &frame, const EvalId &evId,
 			      int col, bool persistent = true) const;
 	Result getResult(const FrameDescriptor &frame,
 			 const EvalId &evId) const;
 	void setResults(const std::string &fName,
 			const std::vector<FrameDescriptor> &frames);
-	const PterosSysTask getSysTask(const FrameDescriptor &frame) const
+	const FrameTask getFrameTask(const FrameDescriptor &frame) const
 	{
 		return _systemLoader.getTask(frame);
 	}
@@ -268,6 +283,21 @@ private:
 		return getTask(CacheKey(frame, evId), persistent);
 	}
 	const Task &makeTask(const CacheKey &key, bool persistent) const;
+	// Statistics of the pair of AVs av1, av2 (in any order) in the frame,
+	// shared by all evaluators of the pair. They are computed for R0s and
+	// for the Forster radii of all other evaluators of the pair (see
+	// AbstractEvaluator::forsterRadii()), so that one pass over the pairs
+	// of points serves all of them.
+	const PairTask &getPairTask(const FrameDescriptor &frame, EvalId av1,
+				    EvalId av2,
+				    const std::vector<double> &R0s) const;
+	inline void pushPairTask(const PairKey &key) const
+	{
+		auto &oldK = _pairTasksRingBuf[_pairTasksRBpos];
+		_pairTasks.erase(oldK);
+		oldK = key;
+		_pairTasksRBpos = (_pairTasksRBpos + 1) % _tasksRingBufSize;
+	}
 	inline void pushTask(const CacheKey &key) const
 	{
 		auto &oldK = _tasksRingBuf[_tasksRBpos];
@@ -308,12 +338,23 @@ private:
 	size_t _tasksRingBufSize = _maxRunningCount * 3;
 	mutable std::vector<CacheKey> _tasksRingBuf;
 	mutable size_t _tasksRBpos = 0;
+	// same eviction for the pair statistics, worker thread only
+	struct PairEntry {
+		std::vector<double> R0s;
+		PairTask task;
+	};
+	mutable std::unordered_map<PairKey, PairEntry> _pairTasks;
+	mutable std::vector<PairKey> _pairTasksRingBuf;
+	mutable size_t _pairTasksRBpos = 0;
 
 
 	mutable PterosSystemLoader _systemLoader;
 
 	std::unordered_map<std::string, EvalId> _evalNames; // main thread
 	std::unordered_map<EvalId, EvalUPtr> _evals;	    // main thread
+	// Forster radii of the evaluators of each pair of AVs (av1<=av2), see
+	// AbstractEvaluator::forsterRadii(), main thread
+	std::map<std::pair<EvalId, EvalId>, std::vector<double>> _pairRadii;
 	std::vector<EvalUPtr> _removedEvals;
 	EvalId _currentId;   // main thread
 	EvalId _maxStubEval; // main thread
@@ -336,6 +377,7 @@ public:
 	EvalId evaluatorAVOverlap;
 	EvalId evaluatorTrasformationMatrix;
 	EvalId evaluatorEulerAngle;
+	EvalId evaluatorFrameAtoms;
 };
 
 #endif // TASKSTORAGE_H
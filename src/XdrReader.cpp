@@ -0,0 +1,562 @@
+#include "XdrReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+namespace
+{
+const int xtcMagic = 1995;
+const int trrMagic = 1993;
+
+// XDR is big endian
+std::int32_t xdrInt(const char *bytes)
+{
+	const unsigned char *b = reinterpret_cast<const unsigned char *>(bytes);
+	const std::uint32_t u = (std::uint32_t(b[0]) << 24)
+				| (std::uint32_t(b[1]) << 16)
+				| (std::uint32_t(b[2]) << 8) | b[3];
+	std::int32_t value;
+	std::memcpy(&value, &u, 4);
+	return value;
+}
+
+float xdrFloat(const char *bytes)
+{
+	const std::int32_t i = xdrInt(bytes);
+	float value;
+	std::memcpy(&value, &i, 4);
+	return value;
+}
+
+double xdrDouble(const char *bytes)
+{
+	const std::uint64_t hi = std::uint32_t(xdrInt(bytes));
+	const std::uint64_t lo = std::uint32_t(xdrInt(bytes + 4));
+	const std::uint64_t u = (hi << 32) | lo;
+	double value;
+	std::memcpy(&value, &u, 8);
+	return value;
+}
+
+std::int64_t padded(std::int64_t size)
+{
+	return (size + 3) / 4 * 4;
+}
+
+// XTC: magic, natoms, step, time, box[9], natoms, then either the
+// uncompressed coordinates (natoms<=9) or precision, minint[3], maxint[3],
+// smallidx, the number of bytes and the compressed bytes
+const int xtcHeaderSize = 56;
+const int xtcCompressedHeaderSize = 92;
+
+// TRR: magic, string length, version string "GMX_trn_file" (XDR string:
+// length and padded characters), the sizes of the 10 data blocks, natoms,
+// step, nre, then time and lambda in the precision of the data
+const int trrStringOffset = 12;
+const int trrNumInts = 13;
+enum TrrInts {
+	trrIrSize = 0,
+	trrBoxSize = 2,
+	trrXSize = 7,
+	trrVSize,
+	trrFSize,
+	trrNatoms,
+};
+
+// Decompression of the XTC coordinates, as in xdrfile (xdr3dfcoord). Atoms
+// are stored as integer offsets from minint in a mixed radix; consecutive
+// atoms close to each other ("runs", e.g. water) as small differences to
+// the previous atom.
+const int magicints[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64, 80,
+	101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290, 1625,
+	2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003, 16384, 20642,
+	26007, 32768, 41285, 52015, 65536, 82570, 104031, 131072, 165140,
+	208063, 262144, 330280, 416127, 524287, 660561, 832255, 1048576,
+	1321122, 1664510, 2097152, 2642245, 3329021, 4194304, 5284491,
+	6658042, 8388607, 10568983, 13316085, 16777216};
+const int firstIdx = 9;
+const int lastIdx = sizeof(magicints) / sizeof(*magicints);
+
+class BitReader
+{
+public:
+	BitReader(const unsigned char *data, std::int64_t size)
+	    : _data(data), _size(size)
+	{
+	}
+	bool overrun() const
+	{
+		return _pos > _size;
+	}
+	unsigned bits(int nbits)
+	{
+		const std::uint64_t mask = (std::uint64_t(1) << nbits) - 1;
+		std::uint64_t num = 0;
+		while (nbits >= 8) {
+			_lastByte = (_lastByte << 8) | next();
+			num |= (_lastByte >> _lastBits) << (nbits - 8);
+			nbits -= 8;
+		}
+		if (nbits > 0) {
+			if (_lastBits < nbits) {
+				_lastBits += 8;
+				_lastByte = (_lastByte << 8) | next();
+			}
+			_lastBits -= nbits;
+			num |= (_lastByte >> _lastBits) & ((1u << nbits) - 1);
+		}
+		_lastByte &= 0xffff;
+		return num & mask;
+	}
+	// three integers, stored together in nbits as a number with the
+	// radices sizes
+	void ints(int nbits, const unsigned sizes[3], int nums[3])
+	{
+		unsigned bytes[32] = {0};
+		int numBytes = 0;
+		while (nbits > 8) {
+			bytes[numBytes++] = bits(8);
+			nbits -= 8;
+		}
+		if (nbits > 0) {
+			bytes[numBytes++] = bits(nbits);
+		}
+		for (int i = 2; i > 0; --i) {
+			unsigned num = 0;
+			for (int j = numBytes - 1; j >= 0; --j) {
+				num = (num << 8) | bytes[j];
+				const unsigned p = num / sizes[i];
+				bytes[j] = p;
+				num -= p * sizes[i];
+			}
+			nums[i] = num;
+		}
+		nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16)
+			  | (bytes[3] << 24);
+	}
+
+private:
+	unsigned next()
+	{
+		return _pos < _size ? _data[_pos++] : (++_pos, 0);
+	}
+	const unsigned char *_data;
+	std::int64_t _size;
+	std::int64_t _pos = 0;
+	int _lastBits = 0;
+	std::uint64_t _lastByte = 0;
+};
+
+// number of bits to store 0..size-1
+int sizeOfInt(unsigned size)
+{
+	std::uint64_t num = 1;
+	int nbits = 0;
+	while (size >= num && nbits < 32) {
+		++nbits;
+		num <<= 1;
+	}
+	return nbits;
+}
+
+// number of bits to store the numbers with the radices sizes
+int sizeOfInts(const unsigned sizes[3])
+{
+	unsigned bytes[32] = {1};
+	int numBytes = 1;
+	for (int i = 0; i < 3; ++i) {
+		std::uint64_t tmp = 0;
+		int b = 0;
+		for (; b < numBytes; ++b) {
+			tmp = bytes[b] * std::uint64_t(sizes[i]) + tmp;
+			bytes[b] = tmp & 0xff;
+			tmp >>= 8;
+		}
+		while (tmp != 0) {
+			bytes[b++] = tmp & 0xff;
+			tmp >>= 8;
+		}
+		numBytes = b;
+	}
+	unsigned num = 1;
+	int nbits = 0;
+	--numBytes;
+	while (bytes[numBytes] >= num) {
+		++nbits;
+		num *= 2;
+	}
+	return nbits + numBytes * 8;
+}
+
+bool decodeXtc(const std::vector<char> &bytes, int numAtoms,
+	       std::vector<Eigen::Vector3f> &xyz)
+{
+	const char *data = bytes.data();
+	const std::int64_t size = bytes.size();
+	if (size < xtcHeaderSize || xdrInt(data) != xtcMagic
+	    || xdrInt(data + 4) != numAtoms
+	    || xdrInt(data + 52) != numAtoms) {
+		return false;
+	}
+	xyz.resize(numAtoms);
+	if (numAtoms <= 9) {
+		if (size < xtcHeaderSize + 12 * numAtoms) {
+			return false;
+		}
+		const char *f = data + xtcHeaderSize;
+		for (int i = 0; i < numAtoms; ++i, f += 12) {
+			xyz[i] = Eigen::Vector3f(xdrFloat(f), xdrFloat(f + 4),
+						 xdrFloat(f + 8));
+		}
+		return true;
+	}
+	if (size < xtcCompressedHeaderSize) {
+		return false;
+	}
+	const float invPrecision = 1.0f / xdrFloat(data + 56);
+	int minint[3], sizeint[3];
+	unsigned sizes[3];
+	int bitsizeint[3] = {0, 0, 0};
+	bool large = false;
+	for (int k = 0; k < 3; ++k) {
+		minint[k] = xdrInt(data + 60 + 4 * k);
+		sizeint[k] = xdrInt(data + 72 + 4 * k) - minint[k] + 1;
+		sizes[k] = sizeint[k];
+		large = large || sizes[k] > 0xffffff;
+	}
+	int bitsize = 0;
+	if (large) {
+		for (int k = 0; k < 3; ++k) {
+			bitsizeint[k] = sizeOfInt(sizes[k]);
+		}
+	} else {
+		bitsize = sizeOfInts(sizes);
+	}
+	int smallidx = xdrInt(data + 84);
+	const std::int64_t numBytes = xdrInt(data + 88);
+	if (smallidx < firstIdx || smallidx >= lastIdx || numBytes < 0
+	    || size < xtcCompressedHeaderSize + numBytes) {
+		return false;
+	}
+	int smaller = magicints[std::max(firstIdx, smallidx - 1)] / 2;
+	int smallnum = magicints[smallidx] / 2;
+	unsigned sizesmall[3];
+	std::fill(sizesmall, sizesmall + 3, magicints[smallidx]);
+
+	BitReader reader(reinterpret_cast<const unsigned char *>(
+				 data + xtcCompressedHeaderSize),
+			 numBytes);
+	auto store = [&xyz, invPrecision](int i, const int c[3]) {
+		xyz[i] = Eigen::Vector3f(c[0], c[1], c[2]) * invPrecision;
+	};
+	int run = 0;
+	int i = 0;
+	while (i < numAtoms) {
+		int thiscoord[3], prevcoord[3];
+		if (bitsize == 0) {
+			for (int k = 0; k < 3; ++k) {
+				thiscoord[k] = reader.bits(bitsizeint[k]);
+			}
+		} else {
+			reader.ints(bitsize, sizes, thiscoord);
+		}
+		for (int k = 0; k < 3; ++k) {
+			thiscoord[k] += minint[k];
+			prevcoord[k] = thiscoord[k];
+		}
+		int isSmaller = 0;
+		if (reader.bits(1) == 1) {
+			run = reader.bits(5);
+			isSmaller = run % 3;
+			run -= isSmaller;
+			--isSmaller;
+		}
+		if (run > 0 && i + run / 3 >= numAtoms) {
+			return false;
+		}
+		if (run > 0) {
+			for (int k = 0; k < run; k += 3) {
+				reader.ints(smallidx, sizesmall, thiscoord);
+				for (int m = 0; m < 3; ++m) {
+					thiscoord[m] +=
+						prevcoord[m] - smallnum;
+				}
+				if (k == 0) {
+					// the first two atoms are swapped for
+					// a better compression of water
+					std::swap(thiscoord, prevcoord);
+					store(i++, prevcoord);
+				} else {
+					std::copy(thiscoord, thiscoord + 3,
+						  prevcoord);
+				}
+				store(i++, thiscoord);
+			}
+		} else {
+			store(i++, thiscoord);
+		}
+		smallidx += isSmaller;
+		if (smallidx < firstIdx || smallidx >= lastIdx) {
+			return false;
+		}
+		if (isSmaller < 0) {
+			smallnum = smaller;
+			smaller = smallidx > firstIdx
+					  ? magicints[smallidx - 1] / 2
+					  : 0;
+		} else if (isSmaller > 0) {
+			smaller = smallnum;
+			smallnum = magicints[smallidx] / 2;
+		}
+		std::fill(sizesmall, sizesmall + 3, magicints[smallidx]);
+	}
+	return !reader.overrun();
+}
+
+bool decodeTrr(const std::vector<char> &bytes, int numAtoms,
+	       std::vector<Eigen::Vector3f> &xyz)
+{
+	const std::int64_t n = 3 * std::int64_t(numAtoms);
+	const std::int64_t realSize = n > 0 ? bytes.size() / n : 0;
+	if ((realSize != 4 && realSize != 8)
+	    || std::int64_t(bytes.size()) != n * realSize) {
+		return false;
+	}
+	xyz.resize(numAtoms);
+	const char *x = bytes.data();
+	for (int i = 0; i < numAtoms; ++i) {
+		for (int k = 0; k < 3; ++k, x += realSize) {
+			xyz[i][k] = realSize == 4 ? xdrFloat(x) : xdrDouble(x);
+		}
+	}
+	return true;
+}
+} // namespace
+
+XdrReader::XdrReader(const std::string &fileName, Format format)
+    : _fileName(fileName), _format(format),
+      _file(fileName, std::ios::binary)
+{
+	if (!_file) {
+		std::cerr << "ERROR! Can not open " + fileName + "\n"
+			  << std::flush;
+		return;
+	}
+	_file.seekg(0, std::ios::end);
+	const std::int64_t fileSize = _file.tellg();
+	const Stamp fileStamp = stamp(fileSize);
+	const std::string indexName = fileName + ".olgaidx";
+	if (loadIndex(indexName, fileStamp)) {
+		return;
+	}
+	if (!buildIndex(fileSize)) {
+		std::cerr << "ERROR! Can not read " + fileName + "\n"
+			  << std::flush;
+		_numAtoms = 0;
+		_frames.clear();
+		return;
+	}
+	saveIndex(indexName, fileStamp);
+}
+
+XdrReader::Stamp XdrReader::stamp(std::int64_t fileSize)
+{
+	// A trajectory of the same size can be rewritten (e.g. TRR with a fixed
+	// number of atoms), the header of the first and the last frame differ
+	// then, at least in the step and time.
+	Stamp stamp{fileSize, 0, 0xcbf29ce484222325ull};
+	struct stat info;
+	if (stat(_fileName.c_str(), &info) == 0) {
+		stamp.mtime = info.st_mtime;
+	}
+	const std::int64_t chunk = std::min<std::int64_t>(fileSize, 4096);
+	std::vector<char> bytes(chunk);
+	for (const std::int64_t offset : {std::int64_t(0), fileSize - chunk}) {
+		_file.clear();
+		_file.seekg(offset);
+		_file.read(bytes.data(), chunk);
+		for (const char c : bytes) {
+			stamp.checksum = (stamp.checksum
+					  ^ static_cast<unsigned char>(c))
+					 * 0x100000001b3ull;
+		}
+	}
+	_file.clear();
+	return stamp;
+}
+
+bool XdrReader::buildIndex(std::int64_t fileSize)
+{
+	// only the headers are read, the coordinates are skipped
+	std::int64_t offset = 0;
+	char head[xtcCompressedHeaderSize];
+	while (offset < fileSize) {
+		const std::int64_t left = fileSize - offset;
+		_file.clear();
+		_file.seekg(offset);
+		if (_format == Format::XTC) {
+			if (left < xtcHeaderSize
+			    || !_file.read(head, xtcHeaderSize)) {
+				break;
+			}
+			const int natoms = xdrInt(head + 4);
+			if (xdrInt(head) != xtcMagic || natoms <= 0
+			    || (_numAtoms > 0 && natoms != _numAtoms)) {
+				return false;
+			}
+			_numAtoms = natoms;
+			std::int64_t size = xtcHeaderSize + 12 * natoms;
+			if (natoms > 9) {
+				if (left < xtcCompressedHeaderSize
+				    || !_file.read(head + xtcHeaderSize,
+						   xtcCompressedHeaderSize
+							   - xtcHeaderSize)) {
+					break;
+				}
+				size = xtcCompressedHeaderSize
+				       + padded(std::uint32_t(
+					       xdrInt(head + 88)));
+			}
+			if (size > left) {
+				// incomplete last frame
+				break;
+			}
+			_frames.push_back({offset, size});
+			offset += size;
+			continue;
+		}
+		if (left < trrStringOffset
+		    || !_file.read(head, trrStringOffset)) {
+			break;
+		}
+		const std::int64_t stringSize = padded(xdrInt(head + 8));
+		if (xdrInt(head) != trrMagic || stringSize < 0
+		    || stringSize > 64) {
+			return false;
+		}
+		char ints[4 * trrNumInts];
+		const std::int64_t intsOffset = trrStringOffset + stringSize;
+		if (left < intsOffset + std::int64_t(sizeof(ints))
+		    || !_file.seekg(stringSize, std::ios::cur)
+		    || !_file.read(ints, sizeof(ints))) {
+			break;
+		}
+		const int natoms = xdrInt(ints + 4 * trrNatoms);
+		if (natoms <= 0 || (_numAtoms > 0 && natoms != _numAtoms)) {
+			return false;
+		}
+		_numAtoms = natoms;
+		std::int64_t dataSize = 0;
+		for (int k = trrIrSize; k <= trrFSize; ++k) {
+			dataSize += std::uint32_t(xdrInt(ints + 4 * k));
+		}
+		const std::int64_t boxSize = xdrInt(ints + 4 * trrBoxSize);
+		const std::int64_t xSize = xdrInt(ints + 4 * trrXSize);
+		const std::int64_t vSize = xdrInt(ints + 4 * trrVSize);
+		const std::int64_t fSize = xdrInt(ints + 4 * trrFSize);
+		const std::int64_t realSize =
+			boxSize ? boxSize / 9
+				: (xSize ? xSize : vSize ? vSize : fSize)
+					  / (3 * std::int64_t(natoms));
+		if (realSize != 4 && realSize != 8) {
+			return false;
+		}
+		const std::int64_t headerSize =
+			intsOffset + sizeof(ints) + 2 * realSize;
+		if (headerSize + dataSize > left) {
+			break;
+		}
+		if (xSize > 0) {
+			// box, virial and pressure precede the coordinates
+			std::int64_t xOffset = offset + headerSize;
+			for (int k = trrBoxSize; k < trrXSize; ++k) {
+				xOffset += std::uint32_t(xdrInt(ints + 4 * k));
+			}
+			_frames.push_back({xOffset, xSize});
+		}
+		offset += headerSize + dataSize;
+	}
+	return _numAtoms > 0;
+}
+
+bool XdrReader::loadIndex(const std::string &indexName, const Stamp &stamp)
+{
+	const std::int64_t fileSize = stamp.size;
+	std::ifstream in(indexName, std::ios::binary);
+	char magic[8];
+	Stamp saved{0, 0, 0};
+	std::int32_t counts[2] = {0, 0};
+	if (!in.read(magic, 8) || std::memcmp(magic, "OLGAIDX2", 8) != 0
+	    || !in.read(reinterpret_cast<char *>(&saved), sizeof(saved))
+	    || !in.read(reinterpret_cast<char *>(counts), sizeof(counts))
+	    || saved.size != stamp.size || saved.mtime != stamp.mtime
+	    || saved.checksum != stamp.checksum || counts[0] <= 0
+	    || counts[1] < 0) {
+		return false;
+	}
+	std::vector<Span> frames(counts[1]);
+	const std::streamsize bytes = frames.size() * sizeof(Span);
+	if (!in.read(reinterpret_cast<char *>(frames.data()), bytes)) {
+		return false;
+	}
+	for (const Span &span : frames) {
+		if (span.offset < 0 || span.size <= 0
+		    || span.offset + span.size > fileSize) {
+			return false;
+		}
+	}
+	_numAtoms = counts[0];
+	_frames = std::move(frames);
+	return true;
+}
+
+void XdrReader::saveIndex(const std::string &indexName,
+			  const Stamp &stamp) const
+{
+	// e.g. read only storage, the index is rebuilt on the next open then
+	std::ofstream out(indexName, std::ios::binary | std::ios::trunc);
+	const std::int32_t counts[2] = {_numAtoms,
+					std::int32_t(_frames.size())};
+	out.write("OLGAIDX2", 8);
+	out.write(reinterpret_cast<const char *>(&stamp), sizeof(stamp));
+	out.write(reinterpret_cast<const char *>(counts), sizeof(counts));
+	out.write(reinterpret_cast<const char *>(_frames.data()),
+		  _frames.size() * sizeof(Span));
+}
+
+bool XdrReader::readRaw(int frame, RawFrame &raw)
+{
+	if (!valid() || frame < 0 || frame >= numFrames()) {
+		return false;
+	}
+	const Span &span = _frames[frame];
+	raw.format = _format;
+	raw.numAtoms = _numAtoms;
+	raw.bytes.resize(span.size);
+	_file.clear();
+	_file.seekg(span.offset);
+	if (!_file.read(raw.bytes.data(), span.size)) {
+		std::cerr << "ERROR! Can not read frame "
+				     + std::to_string(frame) + " of "
+				     + _fileName + "\n"
+			  << std::flush;
+		return false;
+	}
+	return true;
+}
+
+bool XdrReader::decode(const RawFrame &raw, std::vector<Eigen::Vector3f> &xyz)
+{
+	const bool ok = raw.format == Format::XTC
+				? decodeXtc(raw.bytes, raw.numAtoms, xyz)
+				: decodeTrr(raw.bytes, raw.numAtoms, xyz);
+	if (!ok) {
+		std::cerr << "ERROR! Corrupted trajectory frame\n"
+			  << std::flush;
+	}
+	return ok;
+}
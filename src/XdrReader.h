@@ -0,0 +1,73 @@
+#ifndef XDRREADER_H
+#define XDRREADER_H
+
+#include <Eigen/Dense>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Random access to the frames of GROMACS XTC and TRR trajectories. The
+// frames of these formats differ in size, so on the first open the frame
+// headers are scanned for the byte offsets, which are then saved next to
+// the trajectory (<trajectory>.olgaidx) and reused as long as the size, the
+// modification time and the checksum of the first and last bytes of the
+// trajectory do not change. Reading a frame is split into
+// readRaw(), which only reads the bytes of the frame and is not thread
+// safe, and decode(), which decompresses them and can run on any thread.
+class XdrReader
+{
+public:
+	enum class Format { XTC, TRR };
+	// bytes of a frame, as read from the file
+	struct RawFrame {
+		Format format = Format::XTC;
+		int numAtoms = 0;
+		std::vector<char> bytes;
+	};
+
+	XdrReader(const std::string &fileName, Format format);
+	bool valid() const
+	{
+		return _numAtoms > 0;
+	}
+	int numAtoms() const
+	{
+		return _numAtoms;
+	}
+	// frames with coordinates (TRR frames with only velocities or forces
+	// are skipped)
+	int numFrames() const
+	{
+		return _frames.size();
+	}
+	bool readRaw(int frame, RawFrame &raw);
+	// coordinates of the frame (in nm), false on failure
+	static bool decode(const RawFrame &raw,
+			   std::vector<Eigen::Vector3f> &xyz);
+
+private:
+	// identifies the version of the trajectory, the index belongs to
+	struct Stamp {
+		std::int64_t size;
+		std::int64_t mtime;
+		std::uint64_t checksum;
+	};
+	Stamp stamp(std::int64_t fileSize);
+	bool loadIndex(const std::string &indexName, const Stamp &stamp);
+	void saveIndex(const std::string &indexName, const Stamp &stamp) const;
+	bool buildIndex(std::int64_t fileSize);
+
+	struct Span {
+		std::int64_t offset;
+		std::int64_t size;
+	};
+	std::string _fileName;
+	Format _format;
+	std::ifstream _file;
+	int _numAtoms = 0;
+	std::vector<Span> _frames;
+};
+
+#endif // XDRREADER_H
@@ -14,9 +14,16 @@ SOURCES += \
 
 HEADERS += \
     AV/fretAV.h \
+    AV/OccupancyGrid.h \
     AV/Distance.h \
     AV/MolecularSystemDomain.h \
     EvaluatorSphereAVOverlap.h \
+    AV/AtomCellList.h \
+    AV/AVPoints.h \
+    AV/DistanceHistogram.h \
+    AV/AVOctree.h \
+    AV/RmpConverter.h \
+    AV/SelectionCache.h \
     AV/Position.h \
     AV/PositionSimulation.h \
     AV/PositionSimulationResult.h \
@@ -24,6 +31,7 @@ HEADERS += \
     AbstractCalcResult.h \
     CalcResult.h \
     FrameDescriptor.h \
+    FrameData.h \
     MolecularTrajectory.h \
     AbstractEvaluator.h \
     TaskStorage.h \
@@ -40,25 +48,36 @@ HEADERS += \
     EvaluatorAvFile.h \
     EvaluatorFretEfficiency.h \
     EvaluatorAvVolume.h \
+    EvaluatorFrameAtoms.h \
     split_string.h
 
 SOURCES += \
     AV/fretAV.cpp \
+    AV/OccupancyGrid.cpp \
     AV/Distance.cpp \
     AV/MolecularSystemDomain.cpp \
     EvaluatorSphereAVOverlap.cpp \
+    AV/AtomCellList.cpp \
+    AV/AVPoints.cpp \
+    AV/DistanceHistogram.cpp \
+    AV/AVOctree.cpp \
+    AV/RmpConverter.cpp \
+    AV/SelectionCache.cpp \
     AV/Position.cpp \
     AV/PositionSimulation.cpp \
     AV/PositionSimulationResult.cpp \
     AbstractCalcResult.cpp \
     CalcResult.cpp \
     FrameDescriptor.cpp \
+    FrameData.cpp \
     MolecularTrajectory.cpp \
     AbstractEvaluator.cpp \
     TaskStorage.cpp \
     EvaluatorTrasformationMatrix.cpp \
     EvaluatorEulerAngle.cpp \
     PterosSystemLoader.cpp \
+    DcdReader.cpp \
+    XdrReader.cpp \
     EvaluatorPositionSimulation.cpp \
     EvaluatorDistance.cpp \
     EvaluatorDistanceDistribution.cpp \
@@ -69,4 +88,5 @@ SOURCES += \
     EvaluatorChi2r.cpp \
     EvaluatorAvFile.cpp \
     EvaluatorFretEfficiency.cpp \
-    EvaluatorAvVolume.cpp
+    EvaluatorAvVolume.cpp \
+    EvaluatorFrameAtoms.cpp
@@ -138,7 +138,7 @@ struct NmrRestraint {
 	double r1a, r2a, r3a, r4a, rk2a, rk3a;
 	std::string note;
 	NmrRestraint(const double Fmax1, const double Fmax2, const int iat1,
-		     int iat2, int nstep2, const Distance &dist)
+		     int iat2, int nstep2, const Distance &dist, double Rmp)
 	{
 		using std::to_string;
 		_iat1 = iat1;
@@ -147,7 +147,7 @@ struct NmrRestraint {
 		_nstep2 = nstep2;
 		note = dist.position1() + " (" + to_string(_iat1) + ") <--> "
 		       + dist.position2() + " (" + to_string(_iat2) + ") ";
-		r2 = r3 = dist.RmpFromModelDistance();
+		r2 = r3 = Rmp;
 		r1 = r2 - dist.errNeg();
 		r4 = r3 + dist.errPos();
 		r1a = r1;
@@ -321,6 +321,23 @@ std::ostream &operator<<(std::ostream &os, const NmrRestraint &r)
 	return os;
 }
 
+// Rmp of the AVs, at which their model distance is the one of dist (see
+// RmpConverter), the linear fit if the AVs are not available
+double restraintRmp(const TaskStorage &storage, const FrameDescriptor &frame,
+		    EvalId lp1, EvalId lp2, const Distance &dist)
+{
+	using AvResult = CalcResult<PositionSimulationResult>;
+	auto res1 = std::dynamic_pointer_cast<AvResult>(
+		storage.getResult(frame, lp1));
+	auto res2 = std::dynamic_pointer_cast<AvResult>(
+		storage.getResult(frame, lp2));
+	if (!res1 || !res2 || res1->get().empty() || res2->get().empty()) {
+		return dist.RmpFromModelDistance();
+	}
+	return dist.RmpFromModelDistance(res1->get(), res2->get(),
+					 dist.distance(), 0.01);
+}
+
 const double errAnchor = 2.0;      // Angstrom
 const double FmaxMultAnchor = 2.0; // 2 fold
 int main(int argc, char *argv[])
@@ -508,7 +525,7 @@ int main(int argc, char *argv[])
 		std::shared_ptr<CalcResult<PositionSimulationResult>> calcpos;
 		calcpos = std::static_pointer_cast<
 			CalcResult<PositionSimulationResult>>(res);
-		PositionSimulationResult pos = calcpos->get();
+		const PositionSimulationResult &pos = calcpos->get();
 		if (pos.empty()) {
 			continue;
 		} // stay with old coords
@@ -535,8 +552,9 @@ int main(int argc, char *argv[])
 		int iat1 = av2atomId[lp1];
 		int iat2 = av2atomId[lp2];
 		const Distance &opt = distInfo.at(distId);
+		const double Rmp = restraintRmp(storage, frame, lp1, lp2, opt);
 
-		nmrVec.emplace_back(f1, f2, iat1, iat2, nstep2, opt);
+		nmrVec.emplace_back(f1, f2, iat1, iat2, nstep2, opt, Rmp);
 	}
 	if (!nocap) {
 		nmrVec = NmrRestraint::capForce(nmrVec, atomid2Pos);
@@ -574,7 +592,7 @@ int main(int argc, char *argv[])
 			d.setPosition2(to_string(resids[c]) + "@" + atNames[c]);
 			nmrVec.emplace_back(f1 * FmaxMultAnchor,
 					    f2 * FmaxMultAnchor, iat1, iat2,
-					    nstep2, d);
+					    nstep2, d, d.distance());
 		}
 	}
 	NmrRestraint::save(nmrVec, restraintsFileName.toStdString());
@@ -68,14 +68,14 @@ GetInformativePairsDialog::buildTrajectory(const std::string &sel) const
 	}
 	for (int i = 1; i < numFrames; ++i) {
 		const FrameDescriptor &fr = frames[i];
-		const auto &sysTsk = storage.getSysTask(fr);
+		const auto &frameTsk = storage.getFrameTask(fr);
 
 		if (i + 1 < numFrames) {
 			// prefetch:
-			storage.getSysTask(frames[i + 1]);
+			storage.getFrameTask(frames[i + 1]);
 		}
 
-		System system = sysTsk.get();
+		System system = frameTsk.get().system();
 		system.keep(sel);
 		if (traj.num_atoms() == system.num_atoms()) {
 			traj.frame_append(system.frame(0));
@@ -34,8 +34,15 @@ HEADERS += \
     Q_DebugStream.h \
     EvaluatorSphereAVOverlap.h \
     AV/fretAV.h \
+    AV/OccupancyGrid.h \
     AV/Distance.h \
     AV/MolecularSystemDomain.h \
+    AV/AtomCellList.h \
+    AV/AVPoints.h \
+    AV/DistanceHistogram.h \
+    AV/AVOctree.h \
+    AV/RmpConverter.h \
+    AV/SelectionCache.h \
     AV/Position.h \
     AV/PositionSimulation.h \
     AV/PositionSimulationResult.h \
@@ -43,6 +50,7 @@ HEADERS += \
     AbstractCalcResult.h \
     CalcResult.h \
     FrameDescriptor.h \
+    FrameData.h \
     MolecularTrajectory.h \
     TrajectoriesTreeModel.h \
     TrajectoriesTreeItem.h \
@@ -51,6 +59,8 @@ HEADERS += \
     EvaluatorTrasformationMatrix.h \
     EvaluatorEulerAngle.h \
     PterosSystemLoader.h \
+    DcdReader.h \
+    XdrReader.h \
     EvaluatorPositionSimulation.h \
     EvaluatorDistance.h \
     EvaluatorDistanceDistribution.h \
@@ -65,6 +75,7 @@ HEADERS += \
     EvaluatorAvFile.h \
     EvaluatorFretEfficiency.h \
     EvaluatorAvVolume.h \
+    EvaluatorFrameAtoms.h \
     BatchLPDialog.h \
     BatchDistanceDialog.h \
     GetInformativePairsDialog.h \
@@ -82,14 +93,22 @@ SOURCES += \
     mainwindow.cpp \
     EvaluatorSphereAVOverlap.cpp \
     AV/fretAV.cpp \
+    AV/OccupancyGrid.cpp \
     AV/Distance.cpp \
     AV/MolecularSystemDomain.cpp \
+    AV/AtomCellList.cpp \
+    AV/AVPoints.cpp \
+    AV/DistanceHistogram.cpp \
+    AV/AVOctree.cpp \
+    AV/RmpConverter.cpp \
+    AV/SelectionCache.cpp \
     AV/Position.cpp \
     AV/PositionSimulation.cpp \
     AV/PositionSimulationResult.cpp \
     AbstractCalcResult.cpp \
     CalcResult.cpp \
     FrameDescriptor.cpp \
+    FrameData.cpp \
     MolecularTrajectory.cpp \
     TrajectoriesTreeModel.cpp \
     TrajectoriesTreeItem.cpp \
@@ -98,6 +117,8 @@ SOURCES += \
     EvaluatorTrasformationMatrix.cpp \
     EvaluatorEulerAngle.cpp \
     PterosSystemLoader.cpp \
+    DcdReader.cpp \
+    XdrReader.cpp \
     EvaluatorPositionSimulation.cpp \
     EvaluatorDistance.cpp \
     EvaluatorDistanceDistribution.cpp \
@@ -112,6 +133,7 @@ SOURCES += \
     EvaluatorAvFile.cpp \
     EvaluatorFretEfficiency.cpp \
     EvaluatorAvVolume.cpp \
+    EvaluatorFrameAtoms.cpp \
     BatchLPDialog.cpp \
     BatchDistanceDialog.cpp \
     GetInformativePairsDialog.cpp \
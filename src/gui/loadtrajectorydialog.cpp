@@ -35,6 +35,6 @@ void LoadTrajectoryDialog::browseTrajectory()
 {
 	QString fileName = QFileDialog::getOpenFileName(
 		this, tr("Pick a trajectory file"), "",
-		tr("Molecular Trajectory files (*.dcd)"));
+		tr("Molecular Trajectory files (*.dcd *.xtc *.trr)"));
 	ui->trajectoryLineEdit->setText(fileName);
 }
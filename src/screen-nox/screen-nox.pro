@@ -18,14 +18,22 @@ VPATH += ../
 SOURCES += \
     main.cpp \
     AV/fretAV.cpp \
+    AV/OccupancyGrid.cpp \
     AV/Distance.cpp \
     AV/MolecularSystemDomain.cpp \
+    AV/AtomCellList.cpp \
+    AV/AVPoints.cpp \
+    AV/DistanceHistogram.cpp \
+    AV/AVOctree.cpp \
+    AV/RmpConverter.cpp \
+    AV/SelectionCache.cpp \
     AV/Position.cpp \
     AV/PositionSimulation.cpp \
     AV/PositionSimulationResult.cpp \
     TaskStorage.cpp \
     EvaluatorAvFile.cpp \
     EvaluatorAvVolume.cpp \
+    EvaluatorFrameAtoms.cpp \
     EvaluatorChi2.cpp \
     EvaluatorChi2Contribution.cpp \
     EvaluatorChi2r.cpp \
@@ -39,21 +47,32 @@ SOURCES += \
     EvaluatorTrasformationMatrix.cpp \
     EvaluatorWeightedResidual.cpp \
     FrameDescriptor.cpp \
+    FrameData.cpp \
     PterosSystemLoader.cpp \
+    DcdReader.cpp \
+    XdrReader.cpp \
     AbstractCalcResult.cpp \
     CalcResult.cpp \
     AbstractEvaluator.cpp
 
 HEADERS += \
     AV/fretAV.h \
+    AV/OccupancyGrid.h \
     AV/Distance.h \
     AV/MolecularSystemDomain.h \
+    AV/AtomCellList.h \
+    AV/AVPoints.h \
+    AV/DistanceHistogram.h \
+    AV/AVOctree.h \
+    AV/RmpConverter.h \
+    AV/SelectionCache.h \
     AV/Position.h \
     AV/PositionSimulation.h \
     AV/PositionSimulationResult.h \
     TaskStorage.h \
     EvaluatorAvFile.h \
     EvaluatorAvVolume.h \
+    EvaluatorFrameAtoms.h \
     EvaluatorChi2.h \
     EvaluatorChi2Contribution.h \
     EvaluatorChi2r.h \
@@ -67,7 +86,10 @@ HEADERS += \
     EvaluatorTrasformationMatrix.h \
     EvaluatorWeightedResidual.h \
     FrameDescriptor.h \
+    FrameData.h \
     PterosSystemLoader.h \
+    DcdReader.h \
+    XdrReader.h \
     AbstractCalcResult.h \
     CalcResult.h \
     AbstractEvaluator.h